@@ -0,0 +1,310 @@
+// Ahead of time compilation
+//
+// Same builders and IR pipeline as the JIT, but code is written out instead of run:
+// - prebuilt kernels cost nothing at startup, the JIT stays for code specialized at runtime
+// - the header is generated from the IR signatures so it can't drift from the code
+
+#include <llvm-c/Target.h>
+#include <llvm-c/TargetMachine.h>
+
+#include "aot.h"
+#include "opt.h"
+#include "util.h"
+
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+AotKind aot_kind_from_path (
+  const char* path
+)
+{
+  size_t len = strlen(path);
+
+  return len > 3 && strcmp(path + len - 3, ".so") == 0 ? AOT_SHARED : AOT_OBJECT;
+}
+
+static LLVMTargetMachineRef create_aot_target_machine (
+  LLVMModuleRef mod,
+  AotOpts opts
+)
+{
+  const char* triple = LLVMGetTarget(mod);
+  LLVMTargetRef target_ref;
+  char* err = NULL;
+
+  if (LLVMGetTargetFromTriple(triple, &target_ref, &err))
+  {
+    fprintf(stderr, "Error: %s\n", err);
+    LLVMDisposeMessage(err);
+    return NULL;
+  }
+
+  char* cpu      = opts.host_cpu ? LLVMGetHostCPUName() : NULL;
+  char* features = opts.host_cpu ? LLVMGetHostCPUFeatures() : NULL;
+
+  LLVMCodeGenOptLevel levels[] = { LLVMCodeGenLevelNone, LLVMCodeGenLevelLess, LLVMCodeGenLevelDefault, LLVMCodeGenLevelAggressive };
+  LLVMCodeGenOptLevel level    = levels[opts.opt_level]; // Validated by aot_emit
+
+  LLVMTargetMachineRef tm_ref = LLVMCreateTargetMachine(
+    target_ref,               //
+    triple,                   //
+    cpu ? cpu : "",           // const char* cpu
+    features ? features : "", // const char* features
+    level,                    // level
+    LLVMRelocPIC,             // reloc, PIE executables and shared libraries both need it
+    LLVMCodeModelDefault      // code model
+  );
+
+  LLVMDisposeMessage(cpu);
+  LLVMDisposeMessage(features);
+
+  return tm_ref;
+}
+
+#define AOT_MAX_CC_WORDS 32
+
+// LLVM has no C API for linking, run `$CC -shared -o path obj_path` (no shell, paths are passed as is)
+// - $CC is split on whitespace (no quoting) so e.g. "ccache gcc" or "gcc -m64" work like they do in make
+static int link_shared (
+  const char* path,
+  const char* obj_path
+)
+{
+  const char* cc = getenv("CC") && getenv("CC")[0] ? getenv("CC") : "cc";
+  char* words    = strdup(cc);
+  char* argv[AOT_MAX_CC_WORDS + 5];
+  int argc       = 0;
+
+  for (char* word = strtok(words, " \t"); word && argc < AOT_MAX_CC_WORDS; word = strtok(NULL, " \t"))
+  {
+    argv[argc++] = word;
+  }
+
+  if (argc == 0)
+  {
+    fprintf(stderr, "CC is blank\n");
+    free(words);
+    return 1;
+  }
+
+  argv[argc++] = "-shared";
+  argv[argc++] = "-o";
+  argv[argc++] = (char*) path;
+  argv[argc++] = (char*) obj_path;
+  argv[argc]   = NULL;
+
+  pid_t pid = fork();
+
+  if (pid < 0)
+  {
+    perror("fork");
+    free(words);
+    return 1;
+  }
+
+  if (pid == 0)
+  {
+    execvp(argv[0], argv);
+    perror(argv[0]);
+    _exit(127);
+  }
+
+  int status = 0;
+  int ret    = 0;
+
+  if (waitpid(pid, &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    fprintf(stderr, "Failed to link %s w/ %s\n", path, cc);
+    ret = 1;
+  }
+
+  free(words);
+
+  return ret;
+}
+
+int aot_emit (
+  LLVMModuleRef mod,
+  const char* path,
+  AotOpts opts
+)
+{
+  if (opts.opt_level > 3)
+  {
+    fprintf(stderr, "Opt level must be 0-3, got %u\n", opts.opt_level);
+    return 1;
+  }
+
+  LLVMTargetMachineRef tm_ref = create_aot_target_machine(mod, opts);
+  if (!tm_ref) return 1;
+
+  // Optimize a clone, `mod` stays as built
+  LLVMModuleRef aot_mod = LLVMCloneModule(mod);
+
+  if (opts.host_cpu) target_host_cpu(aot_mod);
+  optimize_module(aot_mod, opts.opt_level);
+
+  // Shared libraries are linked from an object next to them
+  size_t len     = strlen(path);
+  char* obj_path = malloc(len + 3);
+
+  strcpy(obj_path, path);
+  if (opts.kind == AOT_SHARED) strcat(obj_path, ".o");
+
+  char* err = NULL;
+  int ret   = 0;
+
+  if (LLVMTargetMachineEmitToFile(tm_ref, aot_mod, obj_path, LLVMObjectFile, &err))
+  {
+    fprintf(stderr, "Failed to emit %s: %s\n", obj_path, err);
+    LLVMDisposeMessage(err);
+    ret = 1;
+  }
+  else if (opts.kind == AOT_SHARED)
+  {
+    ret = link_shared(path, obj_path);
+    remove(obj_path);
+  }
+
+  free(obj_path);
+  LLVMDisposeModule(aot_mod);
+  LLVMDisposeTargetMachine(tm_ref);
+
+  return ret;
+}
+
+//--- Header ---
+
+// C type for an LLVM param/return type, `is_unsigned` from its zeroext attribute
+// - returns 0 if there is no C equivalent (e.g. i256)
+static int print_c_type (
+  FILE* out,
+  LLVMTypeRef type,
+  int is_unsigned
+)
+{
+  switch (LLVMGetTypeKind(type))
+  {
+    case LLVMVoidTypeKind:   fprintf(out, "void"); return T;
+    case LLVMFloatTypeKind:  fprintf(out, "float"); return T;
+    case LLVMDoubleTypeKind: fprintf(out, "double"); return T;
+
+    case LLVMIntegerTypeKind:
+    {
+      unsigned num_bits = LLVMGetIntTypeWidth(type);
+      const char* sign  = is_unsigned ? "u" : "";
+
+      if (num_bits == 1) fprintf(out, "_Bool");
+      else if (num_bits <= 8) fprintf(out, "%sint8_t", sign);
+      else if (num_bits <= 16) fprintf(out, "%sint16_t", sign);
+      else if (num_bits <= 32) fprintf(out, "%sint32_t", sign);
+      else if (num_bits <= 64) fprintf(out, "%sint64_t", sign);
+      else if (num_bits <= 128) fprintf(out, is_unsigned ? "unsigned __int128" : "__int128");
+      else return F;
+
+      return T;
+    }
+
+    case LLVMPointerTypeKind:
+    {
+      LLVMTypeRef elem_type = LLVMGetElementType(type);
+      LLVMTypeKind pointee  = LLVMGetTypeKind(elem_type);
+
+      if (pointee == LLVMIntegerTypeKind || pointee == LLVMFloatTypeKind || pointee == LLVMDoubleTypeKind || pointee == LLVMPointerTypeKind)
+      {
+        if (!print_c_type(out, elem_type, F)) return F;
+      }
+      else
+      {
+        fprintf(out, "void");
+      }
+
+      fprintf(out, "*");
+      return T;
+    }
+
+    default: fprintf(out, "void*"); return T; // Structs/vectors/arrays aren't passed by value by the builders
+  }
+}
+
+// zeroext on a return (LLVMAttributeReturnIndex) or param (1 + param #), see set_int_ret_ext
+static int is_zeroext (
+  LLVMValueRef fn,
+  LLVMAttributeIndex index
+)
+{
+  unsigned kind = LLVMGetEnumAttributeKindForName("zeroext", 7);
+
+  return LLVMGetEnumAttributeAtIndex(fn, index, kind) != NULL;
+}
+
+int aot_write_header (
+  LLVMModuleRef mod,
+  const char* path
+)
+{
+  FILE* out = fopen(path, "w");
+
+  if (!out)
+  {
+    fprintf(stderr, "Failed to open %s\n", path);
+    return 1;
+  }
+
+  // Include guard from the file name, e.g. out/kernels.h -> AOT_KERNELS_H
+  // - prefixed so names starting w/ a digit (3d.h) still give an identifier
+  const char* base = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+  char guard[256]  = "AOT_";
+  size_t len       = strlen(guard);
+
+  for (size_t i = 0; base[i] && len < sizeof(guard) - 1; i++)
+  {
+    guard[len++] = isalnum((unsigned char) base[i]) ? toupper((unsigned char) base[i]) : '_';
+  }
+
+  guard[len] = '\0';
+
+  size_t id_len;
+  fprintf(out, "// Generated from module %s, do not edit\n\n", LLVMGetModuleIdentifier(mod, &id_len));
+  fprintf(out, "#ifndef %s\n#define %s\n\n#include <stdint.h>\n\n", guard, guard);
+  fprintf(out, "#ifdef __cplusplus\nextern \"C\" {\n#endif\n\n");
+
+  int ok = T;
+
+  for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn && ok; fn = LLVMGetNextFunction(fn))
+  {
+    if (LLVMIsDeclaration(fn) || LLVMGetLinkage(fn) == LLVMInternalLinkage || LLVMGetLinkage(fn) == LLVMPrivateLinkage) continue;
+
+    LLVMTypeRef signature = LLVMGlobalGetValueType(fn);
+    unsigned num_params   = LLVMCountParamTypes(signature);
+    LLVMTypeRef* params   = malloc(sizeof(LLVMTypeRef) * (num_params ? num_params : 1));
+
+    LLVMGetParamTypes(signature, params);
+
+    ok = print_c_type(out, LLVMGetReturnType(signature), is_zeroext(fn, LLVMAttributeReturnIndex));
+    fprintf(out, " %s (", LLVMGetValueName(fn));
+
+    if (num_params == 0) fprintf(out, "void");
+
+    for (unsigned p = 0; p < num_params && ok; p++)
+    {
+      if (p) fprintf(out, ", ");
+      ok = print_c_type(out, params[p], is_zeroext(fn, p + 1));
+    }
+
+    fprintf(out, ");\n");
+    free(params);
+
+    if (!ok) fprintf(stderr, "%s: signature has no C equivalent\n", LLVMGetValueName(fn));
+  }
+
+  fprintf(out, "\n#ifdef __cplusplus\n}\n#endif\n\n#endif\n");
+  fclose(out);
+
+  if (!ok) remove(path);
+
+  return !ok;
+}
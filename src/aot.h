@@ -0,0 +1,41 @@
+#ifndef AOT_H
+#define AOT_H
+
+#include <llvm-c/Core.h>
+
+// Ahead of time output, picked from the path's extension (.so: shared library, anything else: object)
+typedef enum {
+  AOT_OBJECT, // Relocatable object, link it like any other .o
+  AOT_SHARED  // Shared library, linked from the object w/ the system C compiler
+} AotKind;
+
+typedef struct {
+  AotKind kind;
+  unsigned opt_level; // Same IR pipeline as the JIT, 0-3 (aot_emit fails otherwise)
+  int host_cpu;       // Tune for (and require) this machine's CPU, otherwise generic for the module's triple
+} AotOpts;
+
+AotKind aot_kind_from_path (
+  const char* path
+);
+
+// Optimize a clone of `mod` and emit it as native code for the module's triple w/ LLVMTargetMachineEmitToFile
+// - code is position independent so objects can go into PIE executables and shared libraries
+// - .so outputs are linked w/ $CC (default cc), split on whitespace e.g. "ccache gcc"
+// - returns 0 on success
+int aot_emit (
+  LLVMModuleRef mod,
+  const char* path,
+  AotOpts opts
+);
+
+// Write a C header w/ a prototype for every fn defined in `mod`
+// - iN maps to the smallest intN_t that holds it (uintN_t when zeroext), i65 to i128 map to __int128
+// - pointers to scalars keep their pointee, other pointers (e.g. structs) become void*
+// - returns 0 on success, fails (and writes nothing) when a signature has no C equivalent, e.g. i256
+int aot_write_header (
+  LLVMModuleRef mod,
+  const char* path
+);
+
+#endif
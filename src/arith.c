@@ -0,0 +1,144 @@
+// Integer arithmetic shared by the int fn builders
+//
+// Overflow handling per IntMode:
+//
+//    wrap:    %r = add i32 %x, %y
+//    nsw:     %r = add nsw i32 %x, %y
+//    trap:    %res = call { i32, i1 } @llvm.sadd.with.overflow.i32(i32 %x, i32 %y)
+//             %r   = extractvalue { i32, i1 } %res, 0
+//             %ovf = extractvalue { i32, i1 } %res, 1
+//             br i1 %ovf, label %overflow, label %no_overflow
+//    sat:     %r = call i32 @llvm.sadd.sat.i32(i32 %x, i32 %y)
+
+#include "arith.h"
+#include "intrinsic.h"
+#include "util.h"
+
+#include <string.h>
+
+int int_mode_is_unsigned (
+  IntMode mode
+)
+{
+  return mode == INT_NUW || mode == INT_TRAP_UNSIGNED || mode == INT_SAT_UNSIGNED;
+}
+
+unsigned int_storage_bits (
+  unsigned num_bits
+)
+{
+  unsigned bits = 8;
+
+  while (bits < num_bits) bits *= 2;
+
+  return bits;
+}
+
+void set_int_ret_ext (
+  LLVMContextRef ctx,
+  LLVMValueRef fn,
+  unsigned num_bits,
+  IntMode mode
+)
+{
+  if (num_bits >= sizeof(int) * 8) return;
+
+  const char* kind_name = int_mode_is_unsigned(mode) ? "zeroext" : "signext";
+  unsigned kind         = LLVMGetEnumAttributeKindForName(kind_name, strlen(kind_name));
+
+  LLVMAddAttributeAtIndex(fn, LLVMAttributeReturnIndex, LLVMCreateEnumAttribute(ctx, kind, 0));
+}
+
+// {result, overflow} = llvm.[su]add.with.overflow(x, y), branch to a trap on overflow
+static LLVMValueRef build_trapping_add (
+  LLVMBuilderRef builder,
+  LLVMModuleRef mod,
+  const char* intrinsic,
+  LLVMValueRef x,
+  LLVMValueRef y,
+  const char* name
+)
+{
+  LLVMContextRef ctx = LLVMGetModuleContext(mod);
+  LLVMTypeRef type   = LLVMTypeOf(x);
+  LLVMValueRef fn    = LLVMGetBasicBlockParent(LLVMGetInsertBlock(builder));
+
+  // Add
+  LLVMTypeRef signature;
+  LLVMValueRef add_fn   = get_intrinsic(mod, intrinsic, &type, 1, &signature);
+  LLVMValueRef args[]   = { x, y };
+  LLVMValueRef res      = LLVMBuildCall2(builder, signature, add_fn, args, 2, "");
+  LLVMValueRef sum      = LLVMBuildExtractValue(builder, res, 0, name);
+  LLVMValueRef overflow = LLVMBuildExtractValue(builder, res, 1, "overflow");
+
+  // Vector: any lane overflowed (<N x i1> -> iN != 0)
+  if (LLVMGetTypeKind(type) == LLVMVectorTypeKind)
+  {
+    LLVMTypeRef mask_type = LLVMIntTypeInContext(ctx, LLVMGetVectorSize(type));
+    LLVMValueRef mask     = LLVMBuildBitCast(builder, overflow, mask_type, "");
+
+    overflow = LLVMBuildICmp(builder, LLVMIntNE, mask, LLVMConstNull(mask_type), "overflow");
+  }
+
+  // Create blocks
+  LLVMBasicBlockRef trap        = LLVMAppendBasicBlockInContext(ctx, fn, "overflow");
+  LLVMBasicBlockRef no_overflow = LLVMAppendBasicBlockInContext(ctx, fn, "no_overflow");
+
+  LLVMBuildCondBr(builder, overflow, trap, no_overflow);
+
+  // Trap
+  LLVMPositionBuilderAtEnd(builder, trap);
+
+  {
+    LLVMTypeRef trap_type;
+    LLVMValueRef trap_fn = get_intrinsic(mod, "llvm.trap", NULL, 0, &trap_type);
+
+    LLVMBuildCall2(builder, trap_type, trap_fn, NULL, 0, "");
+    LLVMBuildUnreachable(builder);
+  }
+
+  // Continue
+  LLVMPositionBuilderAtEnd(builder, no_overflow);
+
+  return sum;
+}
+
+LLVMValueRef build_int_add (
+  LLVMBuilderRef builder,
+  LLVMModuleRef mod,
+  IntMode mode,
+  LLVMValueRef x,
+  LLVMValueRef y,
+  const char* name
+)
+{
+  switch (mode)
+  {
+    case INT_NSW:
+      return LLVMBuildNSWAdd(builder, x, y, name);
+
+    case INT_NUW:
+      return LLVMBuildNUWAdd(builder, x, y, name);
+
+    case INT_TRAP_SIGNED:
+      return build_trapping_add(builder, mod, "llvm.sadd.with.overflow", x, y, name);
+
+    case INT_TRAP_UNSIGNED:
+      return build_trapping_add(builder, mod, "llvm.uadd.with.overflow", x, y, name);
+
+    case INT_SAT_SIGNED:
+    case INT_SAT_UNSIGNED:
+    {
+      LLVMTypeRef type    = LLVMTypeOf(x);
+      LLVMTypeRef signature;
+      LLVMValueRef sat_fn = get_intrinsic(mod, mode == INT_SAT_SIGNED ? "llvm.sadd.sat" : "llvm.uadd.sat", &type, 1, &signature);
+      LLVMValueRef args[] = { x, y };
+
+      return LLVMBuildCall2(builder, signature, sat_fn, args, 2, name);
+    }
+
+    case INT_WRAP:
+    default:
+      return LLVMBuildAdd(builder, x, y, name);
+  }
+}
@@ -0,0 +1,46 @@
+#ifndef ARITH_H
+#define ARITH_H
+
+#include <llvm-c/Core.h>
+
+// How integer adds handle overflow
+typedef enum {
+  INT_WRAP,          // add, two's complement wrap
+  INT_NSW,           // add nsw, signed overflow is poison (lets the optimizer assume it can't happen)
+  INT_NUW,           // add nuw, unsigned overflow is poison
+  INT_TRAP_SIGNED,   // llvm.sadd.with.overflow, traps on overflow
+  INT_TRAP_UNSIGNED, // llvm.uadd.with.overflow, traps on overflow
+  INT_SAT_SIGNED,    // llvm.sadd.sat, clamps to [INT_MIN, INT_MAX]
+  INT_SAT_UNSIGNED   // llvm.uadd.sat, clamps to [0, UINT_MAX]
+} IntMode;
+
+int int_mode_is_unsigned (
+  IntMode mode
+);
+
+// Smallest byte multiple, power of 2 width that holds `num_bits` (i17 -> i32)
+unsigned int_storage_bits (
+  unsigned num_bits
+);
+
+// Mark return value of a fn returning i<num_bits> as sign/zero extended (per mode) when narrower than a C int
+// - C callers read a full register, w/o this the bits above num_bits are garbage (e.g. for i8, i16, i17)
+void set_int_ret_ext (
+  LLVMContextRef ctx,
+  LLVMValueRef fn,
+  unsigned num_bits,
+  IntMode mode
+);
+
+// Emits x + y per mode, works on ints and vectors of ints
+// - trap modes add an overflow block and leave builder positioned in the continuation block
+LLVMValueRef build_int_add (
+  LLVMBuilderRef builder,
+  LLVMModuleRef mod,
+  IntMode mode,
+  LLVMValueRef x,
+  LLVMValueRef y,
+  const char* name
+);
+
+#endif
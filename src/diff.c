@@ -0,0 +1,1511 @@
+// Differential testing of the generated fns
+//
+// Every fn is run under each DiffConfig w/ the same randomized inputs and checked against a plain C reference:
+// - interpreter catches codegen bugs, MCJIT -O0 vs -O3 catches optimizer-exposed bugs (UB in the IR, bad flags, ...)
+// - pointer args live in buffers w/ PROT_NONE guard pages on both sides
+//   - buffer alternates between flush against the leading and the trailing guard
+//   - any out-of-bounds access faults, the fault is caught and reported instead of crashing
+// - seed is printed so a failing run can be reproduced
+
+#include <llvm-c/ExecutionEngine.h>
+
+#include "diff.h"
+#include "gep.h"
+#include "opt.h"
+#include "util.h"
+
+#include <limits.h>
+#include <stdint.h>
+#include <setjmp.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+typedef struct {
+  DiffConfig config;
+  const char* name;
+  LLVMModuleRef src;
+  LLVMExecutionEngineRef engine;
+  LLVMTypeRef int8_type;
+  LLVMTypeRef int32_type;
+  LLVMTypeRef int64_type;
+} DiffEngine;
+
+static const char* config_names[DIFF_NUM_CONFIGS] = { "interp", "mcjit-O0", "mcjit-O3" };
+
+//--- Random inputs ---
+
+static unsigned long long rng_next (
+  unsigned long long* state
+)
+{
+  // xorshift64*
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+
+  return *state * 2685821657736338717ULL;
+}
+
+static int rand_range (
+  unsigned long long* state,
+  int lo,
+  int hi
+)
+{
+  return lo + (int) (rng_next(state) % (unsigned long long) (hi - lo + 1));
+}
+
+static int rand_int (
+  unsigned long long* state
+)
+{
+  // Bias towards edge cases, otherwise wrapping bugs are practically never hit
+  static const int edges[] = { 0, 1, -1, 2, INT_MIN, INT_MAX, INT_MIN + 1, INT_MAX - 1 };
+
+  if (rng_next(state) % 4 == 0)
+  {
+    return edges[rng_next(state) % LEN(edges)];
+  }
+
+  return (int) (unsigned) rng_next(state);
+}
+
+static double rand_dbl (
+  unsigned long long* state
+)
+{
+  return ((double) (rng_next(state) >> 11) / (double) (1ULL << 53)) * 2000.0 - 1000.0;
+}
+
+//--- Guarded buffers ---
+
+typedef struct {
+  char* map;
+  size_t map_len;
+} GuardBuf;
+
+// Maps [guard][data...][guard] and returns `bytes` placed flush against the leading (or trailing) guard
+static void* guard_alloc (
+  GuardBuf* buf,
+  size_t bytes,
+  int flush_end
+)
+{
+  size_t page_size  = (size_t) sysconf(_SC_PAGESIZE);
+  size_t data_pages = bytes ? (bytes + page_size - 1) / page_size : 1;
+
+  buf->map_len = (data_pages + 2) * page_size;
+  buf->map     = mmap(NULL, buf->map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+  if (buf->map == MAP_FAILED)
+  {
+    perror("mmap");
+    abort();
+  }
+
+  mprotect(buf->map, page_size, PROT_NONE);
+  mprotect(buf->map + (data_pages + 1) * page_size, page_size, PROT_NONE);
+
+  char* data = buf->map + page_size;
+
+  return flush_end ? data + data_pages * page_size - bytes : data;
+}
+
+static void guard_free (
+  GuardBuf* buf
+)
+{
+  munmap(buf->map, buf->map_len);
+}
+
+//--- Fault catching ---
+// - SIGSEGV/SIGBUS are out-of-bounds accesses, SIGILL is llvm.trap (trapping IntModes)
+// - longjmp out of the handler skips whatever the faulting engine had in flight (leaks are fine for a test run)
+
+static sigjmp_buf fault_jmp;
+static volatile sig_atomic_t fault_armed = F;
+static volatile sig_atomic_t fault_sig   = 0;
+
+static void on_fault (
+  int sig
+)
+{
+  if (fault_armed)
+  {
+    fault_armed = F;
+    fault_sig   = sig;
+    siglongjmp(fault_jmp, 1);
+  }
+
+  signal(sig, SIG_DFL);
+  raise(sig);
+}
+
+//--- Engines ---
+
+static int create_engine (
+  DiffEngine* e,
+  LLVMModuleRef mod,
+  DiffConfig config
+)
+{
+  LLVMContextRef ctx  = LLVMGetModuleContext(mod);
+  LLVMModuleRef clone = LLVMCloneModule(mod); // Engine takes ownership
+  char* err           = NULL;
+  int failed          = 0;
+
+  e->config     = config;
+  e->name       = config_names[config];
+  e->src        = mod;
+  e->engine     = NULL;
+  e->int8_type  = LLVMInt8TypeInContext(ctx);
+  e->int32_type = LLVMInt32TypeInContext(ctx);
+  e->int64_type = LLVMInt64TypeInContext(ctx);
+
+  if (config == DIFF_INTERP)
+  {
+    failed = LLVMCreateInterpreterForModule(&e->engine, clone, &err);
+  }
+  else
+  {
+    struct LLVMMCJITCompilerOptions options;
+    LLVMInitializeMCJITCompilerOptions(&options, sizeof(options));
+    options.OptLevel = config == DIFF_MCJIT_O3 ? 3 : 0;
+
+    if (config == DIFF_MCJIT_O3) target_host_cpu(clone);
+
+    optimize_module(clone, options.OptLevel);
+
+    failed = LLVMCreateMCJITCompilerForModule(&e->engine, clone, &options, sizeof(options), &err);
+  }
+
+  if (failed)
+  {
+    fprintf(stderr, "Failed to create %s engine: %s\n", e->name, err ? err : "(unknown)");
+    LLVMDisposeMessage(err);
+    return 1;
+  }
+
+  return 0;
+}
+
+static LLVMValueRef find_fn (
+  DiffEngine* e,
+  const char* name
+)
+{
+  LLVMValueRef fn = NULL;
+
+  if (LLVMFindFunction(e->engine, name, &fn))
+  {
+    fprintf(stderr, "[%s] missing fn %s\n", e->name, name);
+    abort();
+  }
+
+  return fn;
+}
+
+// (fn, config) pairs skipped so far, reported in the summary so a 2-way comparison isn't mistaken for 3-way
+#define DIFF_MAX_SKIPPED 64
+
+static struct { const char* fn; DiffConfig config; } skipped[DIFF_MAX_SKIPPED];
+static unsigned num_skipped = 0;
+
+static void record_skip (
+  DiffEngine* e,
+  const char* name
+)
+{
+  for (unsigned i = 0; i < num_skipped; i++)
+  {
+    if (skipped[i].config == e->config && strcmp(skipped[i].fn, name) == 0) return;
+  }
+
+  if (num_skipped < DIFF_MAX_SKIPPED)
+  {
+    skipped[num_skipped].fn     = name;
+    skipped[num_skipped].config = e->config;
+    num_skipped++;
+  }
+}
+
+// Interpreter can't lower most intrinsics (aborts on e.g. llvm.sadd.sat), only run fns w/o them there
+static int skip_fn (
+  DiffEngine* e,
+  const char* name
+)
+{
+  if (e->config != DIFF_INTERP) return F;
+
+  LLVMValueRef fn = find_fn(e, name);
+
+  for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn); bb; bb = LLVMGetNextBasicBlock(bb))
+  {
+    for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst; inst = LLVMGetNextInstruction(inst))
+    {
+      if (LLVMGetInstructionOpcode(inst) != LLVMCall) continue;
+
+      LLVMValueRef callee = LLVMGetCalledValue(inst);
+
+      if (LLVMIsAFunction(callee) && LLVMGetIntrinsicID(callee) != 0)
+      {
+        record_skip(e, name);
+        return T;
+      }
+    }
+  }
+
+  return F;
+}
+
+// Interpreter only: run `name` w/ generic args, disposes args
+static LLVMGenericValueRef interp_call (
+  DiffEngine* e,
+  const char* name,
+  LLVMGenericValueRef args[],
+  unsigned num_args
+)
+{
+  LLVMGenericValueRef ret = LLVMRunFunction(e->engine, find_fn(e, name), num_args, args);
+
+  for (unsigned i = 0; i < num_args; i++)
+  {
+    LLVMDisposeGenericValue(args[i]);
+  }
+
+  return ret;
+}
+
+typedef void (*DiffCall) (DiffEngine* e, void* args);
+
+// Returns the signal that ended the call, 0 if it returned normally
+static int guarded_call (
+  DiffCall call,
+  DiffEngine* e,
+  void* args
+)
+{
+  // sigsetjmp's result can't be stored (C11 7.13.1.1), the signal comes back through fault_sig
+  fault_sig = 0;
+
+  if (sigsetjmp(fault_jmp, 1) == 0)
+  {
+    fault_armed = T;
+    call(e, args);
+    fault_armed = F;
+  }
+  else
+  {
+    // Interpreter keeps its own call stack, which is left dangling by the longjmp. Leak it and start fresh
+    if (e->config == DIFF_INTERP && create_engine(e, e->src, DIFF_INTERP)) abort();
+  }
+
+  return fault_sig;
+}
+
+//--- Per fn calls ---
+
+typedef struct { const char* name; unsigned num_bits; int x; int y; int ret; } SumArgs; // i<num_bits> <= 32, returned sign extended
+typedef struct { int8_t x; int8_t y; int8_t ret; } SumSat8Args;
+typedef struct { const char* name; void* result; void* x; void* y; long int len; } SumVecArgs;
+typedef struct { const char* name; unsigned num_bits; int x; int ret; } FibArgs; // i8 or i32
+typedef struct { double* result; double* x; double* y; long int len; } LoopArgs;
+typedef struct { int* ints; int ret; } SndIntArgs;
+typedef struct { Munger* mungers; } MungeArgs;
+typedef struct { ST* s; long int i; long int j; long int k; int* foo_ret; int* st_z_b_ret; } FieldPtrArgs;
+typedef struct { const char* name; void* first; void* second; uint32_t* idx; long int len; long int base_len; } IndexedArgs;
+
+static void call_sum (
+  DiffEngine* e,
+  void* p
+)
+{
+  SumArgs* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMTypeRef int_type       = LLVMIntTypeInContext(LLVMGetModuleContext(e->src), a->num_bits);
+    LLVMGenericValueRef args[] = {
+      LLVMCreateGenericValueOfInt(int_type, (unsigned long long) a->x, T),
+      LLVMCreateGenericValueOfInt(int_type, (unsigned long long) a->y, T)
+    };
+    LLVMGenericValueRef ret = interp_call(e, a->name, args, LEN(args));
+
+    a->ret = (int) LLVMGenericValueToInt(ret, T);
+    LLVMDisposeGenericValue(ret);
+  }
+  else
+  {
+    int (*sum) (int, int) = (int (*) (int, int)) LLVMGetFunctionAddress(e->engine, a->name);
+    a->ret                = sum(a->x, a->y);
+  }
+}
+
+static void call_sum_sat8 (
+  DiffEngine* e,
+  void* p
+)
+{
+  SumSat8Args* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMGenericValueRef args[] = {
+      LLVMCreateGenericValueOfInt(e->int8_type, (unsigned long long) a->x, T),
+      LLVMCreateGenericValueOfInt(e->int8_type, (unsigned long long) a->y, T)
+    };
+    LLVMGenericValueRef ret = interp_call(e, "sum_sat8", args, LEN(args));
+
+    a->ret = (int8_t) LLVMGenericValueToInt(ret, T);
+    LLVMDisposeGenericValue(ret);
+  }
+  else
+  {
+    int8_t (*sum_sat8) (int8_t, int8_t) = (int8_t (*) (int8_t, int8_t)) LLVMGetFunctionAddress(e->engine, "sum_sat8");
+    a->ret                              = sum_sat8(a->x, a->y);
+  }
+}
+
+static void call_sum_vec (
+  DiffEngine* e,
+  void* p
+)
+{
+  SumVecArgs* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMGenericValueRef args[] = {
+      LLVMCreateGenericValueOfPointer(a->result),
+      LLVMCreateGenericValueOfPointer(a->x),
+      LLVMCreateGenericValueOfPointer(a->y),
+      LLVMCreateGenericValueOfInt(e->int64_type, (unsigned long long) a->len, T)
+    };
+
+    LLVMDisposeGenericValue(interp_call(e, a->name, args, LEN(args)));
+  }
+  else
+  {
+    void (*sum_vec) (void*, void*, void*, long int) = (void (*) (void*, void*, void*, long int)) LLVMGetFunctionAddress(e->engine, a->name);
+    sum_vec(a->result, a->x, a->y, a->len);
+  }
+}
+
+static void call_fib (
+  DiffEngine* e,
+  void* p
+)
+{
+  FibArgs* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMTypeRef int_type       = LLVMIntTypeInContext(LLVMGetModuleContext(e->src), a->num_bits);
+    LLVMGenericValueRef args[] = { LLVMCreateGenericValueOfInt(int_type, (unsigned long long) a->x, T) };
+    LLVMGenericValueRef ret    = interp_call(e, a->name, args, LEN(args));
+
+    a->ret = (int) LLVMGenericValueToInt(ret, T);
+    LLVMDisposeGenericValue(ret);
+  }
+  else
+  {
+    // x86-64 returns i8 in al w/o extending it (signext or not), call it as C would
+    if (a->num_bits == 8)
+    {
+      int8_t (*fib) (int8_t) = (int8_t (*) (int8_t)) LLVMGetFunctionAddress(e->engine, a->name);
+      a->ret                 = fib((int8_t) a->x);
+    }
+    else
+    {
+      int (*fib) (int) = (int (*) (int)) LLVMGetFunctionAddress(e->engine, a->name);
+      a->ret           = fib(a->x);
+    }
+  }
+}
+
+static void call_loop (
+  DiffEngine* e,
+  void* p
+)
+{
+  LoopArgs* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMGenericValueRef args[] = {
+      LLVMCreateGenericValueOfPointer(a->result),
+      LLVMCreateGenericValueOfPointer(a->x),
+      LLVMCreateGenericValueOfPointer(a->y),
+      LLVMCreateGenericValueOfInt(e->int64_type, (unsigned long long) a->len, T)
+    };
+
+    LLVMDisposeGenericValue(interp_call(e, "loop", args, LEN(args)));
+  }
+  else
+  {
+    void (*loop) (double*, double*, double*, long int) = (void (*) (double*, double*, double*, long int)) LLVMGetFunctionAddress(e->engine, "loop");
+    loop(a->result, a->x, a->y, a->len);
+  }
+}
+
+static void call_get_snd_int (
+  DiffEngine* e,
+  void* p
+)
+{
+  SndIntArgs* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMGenericValueRef args[] = { LLVMCreateGenericValueOfPointer(a->ints) };
+    LLVMGenericValueRef ret    = interp_call(e, "get_snd_int", args, LEN(args));
+
+    a->ret = (int) LLVMGenericValueToInt(ret, T);
+    LLVMDisposeGenericValue(ret);
+  }
+  else
+  {
+    int (*get_snd_int) (int*) = (int (*) (int*)) LLVMGetFunctionAddress(e->engine, "get_snd_int");
+    a->ret                    = get_snd_int(a->ints);
+  }
+}
+
+static void call_munge (
+  DiffEngine* e,
+  void* p
+)
+{
+  MungeArgs* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMGenericValueRef args[] = { LLVMCreateGenericValueOfPointer(a->mungers) };
+
+    LLVMDisposeGenericValue(interp_call(e, "munge", args, LEN(args)));
+  }
+  else
+  {
+    void (*munge) (Munger*) = (void (*) (Munger*)) LLVMGetFunctionAddress(e->engine, "munge");
+    munge(a->mungers);
+  }
+}
+
+// gather (out, base, ...) and scatter (base, src, ...) share a signature
+static void call_indexed (
+  DiffEngine* e,
+  void* p
+)
+{
+  IndexedArgs* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMGenericValueRef args[] = {
+      LLVMCreateGenericValueOfPointer(a->first),
+      LLVMCreateGenericValueOfPointer(a->second),
+      LLVMCreateGenericValueOfPointer(a->idx),
+      LLVMCreateGenericValueOfInt(e->int64_type, (unsigned long long) a->len, T),
+      LLVMCreateGenericValueOfInt(e->int64_type, (unsigned long long) a->base_len, T)
+    };
+
+    LLVMDisposeGenericValue(interp_call(e, a->name, args, LEN(args)));
+  }
+  else
+  {
+    void (*indexed) (void*, void*, uint32_t*, long int, long int) = (void (*) (void*, void*, uint32_t*, long int, long int)) LLVMGetFunctionAddress(e->engine, a->name);
+    indexed(a->first, a->second, a->idx, a->len, a->base_len);
+  }
+}
+
+static void call_field_ptr (
+  DiffEngine* e,
+  void* p
+)
+{
+  FieldPtrArgs* a = p;
+
+  if (e->config == DIFF_INTERP)
+  {
+    LLVMGenericValueRef foo_args[] = { LLVMCreateGenericValueOfPointer(a->s) };
+    LLVMGenericValueRef foo_ret    = interp_call(e, "foo", foo_args, LEN(foo_args));
+
+    LLVMGenericValueRef st_z_b_args[] = {
+      LLVMCreateGenericValueOfPointer(a->s),
+      LLVMCreateGenericValueOfInt(e->int64_type, (unsigned long long) a->i, T),
+      LLVMCreateGenericValueOfInt(e->int64_type, (unsigned long long) a->j, T),
+      LLVMCreateGenericValueOfInt(e->int64_type, (unsigned long long) a->k, T)
+    };
+    LLVMGenericValueRef st_z_b_ret = interp_call(e, "st_z_b", st_z_b_args, LEN(st_z_b_args));
+
+    a->foo_ret    = LLVMGenericValueToPointer(foo_ret);
+    a->st_z_b_ret = LLVMGenericValueToPointer(st_z_b_ret);
+
+    LLVMDisposeGenericValue(st_z_b_ret);
+    LLVMDisposeGenericValue(foo_ret);
+  }
+  else
+  {
+    int* (*foo)    (ST*)                               = (int* (*) (ST*))                               LLVMGetFunctionAddress(e->engine, "foo");
+    int* (*st_z_b) (ST*, long int, long int, long int) = (int* (*) (ST*, long int, long int, long int)) LLVMGetFunctionAddress(e->engine, "st_z_b");
+
+    a->foo_ret    = foo(a->s);
+    a->st_z_b_ret = st_z_b(a->s, a->i, a->j, a->k);
+  }
+}
+
+//--- Per fn checks ---
+// - each returns number of failures for a single randomized input
+
+static unsigned report_fault (
+  DiffEngine* e,
+  const char* fn,
+  unsigned iter
+)
+{
+  fprintf(stderr, "\t[%s] %s (iter %u): out-of-bounds access\n", e->name, fn, iter);
+  return 1;
+}
+
+// Runs a scalar sum style fn under every config, return value is compared against `expected`
+static unsigned check_sum (
+  DiffEngine engines[],
+  SumArgs* args,
+  int expected,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], args->name)) continue;
+
+    if (guarded_call(call_sum, &engines[i], args))
+    {
+      failures += report_fault(&engines[i], args->name, iter);
+    }
+    else if (args->ret != expected)
+    {
+      fprintf(stderr, "\t[%s] %s %d %d (iter %u): got %d, expected %d\n", engines[i].name, args->name, args->x, args->y, iter, args->ret, expected);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+// Runs a trapping sum style fn under every config, must trap (SIGILL) iff `overflows`, return `expected` otherwise
+static unsigned check_sum_trap (
+  DiffEngine engines[],
+  SumArgs* args,
+  int overflows,
+  int expected,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], args->name)) continue;
+
+    int sig = guarded_call(call_sum, &engines[i], args);
+
+    if (overflows && sig != SIGILL)
+    {
+      fprintf(stderr, "\t[%s] %s %d %d (iter %u): expected a trap, got %s\n", engines[i].name, args->name, args->x, args->y, iter, sig ? strsignal(sig) : "a return");
+      failures++;
+    }
+    else if (!overflows && sig)
+    {
+      fprintf(stderr, "\t[%s] %s %d %d (iter %u): unexpected %s\n", engines[i].name, args->name, args->x, args->y, iter, strsignal(sig));
+      failures++;
+    }
+    else if (!overflows && args->ret != expected)
+    {
+      fprintf(stderr, "\t[%s] %s %d %d (iter %u): got %d, expected %d\n", engines[i].name, args->name, args->x, args->y, iter, args->ret, expected);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+static unsigned diff_sum (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  SumArgs args = { "sum", 32, rand_int(rng), rand_int(rng), 0 };
+  int expected = (int) ((unsigned) args.x + (unsigned) args.y); // Wrapping add
+
+  return check_sum(engines, &args, expected, iter);
+}
+
+// nsw/nuw only promise no overflow, so inputs are halved to keep the sum in range (overflow would be poison)
+static unsigned diff_sum_nsw (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  SumArgs args = { "sum_nsw", 32, rand_int(rng) / 2, rand_int(rng) / 2, 0 };
+
+  return check_sum(engines, &args, args.x + args.y, iter);
+}
+
+static unsigned diff_sum_nuw (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  SumArgs args = { "sum_nuw", 32, (int) ((unsigned) rand_int(rng) / 2), (int) ((unsigned) rand_int(rng) / 2), 0 };
+
+  return check_sum(engines, &args, (int) ((unsigned) args.x + (unsigned) args.y), iter);
+}
+
+static int8_t sat8_ref (
+  int8_t x,
+  int8_t y
+)
+{
+  int sum = x + y;
+
+  return sum > INT8_MAX ? INT8_MAX : sum < INT8_MIN ? INT8_MIN : (int8_t) sum;
+}
+
+static unsigned diff_sum_sat8 (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  SumSat8Args args  = { (int8_t) rand_int(rng), (int8_t) rand_int(rng), 0 };
+  int8_t expected   = sat8_ref(args.x, args.y);
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], "sum_sat8")) continue;
+
+    if (guarded_call(call_sum_sat8, &engines[i], &args))
+    {
+      failures += report_fault(&engines[i], "sum_sat8", iter);
+    }
+    else if (args.ret != expected)
+    {
+      fprintf(stderr, "\t[%s] sum_sat8 %d %d (iter %u): got %d, expected %d\n", engines[i].name, args.x, args.y, iter, args.ret, expected);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+// Runs a sum_vec style fn under every config, result buffer is compared against `expected`
+static unsigned check_sum_vec (
+  DiffEngine engines[],
+  SumVecArgs* args,
+  const void* expected,
+  size_t bytes,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], args->name)) continue;
+
+    memset(args->result, 0, bytes);
+
+    if (guarded_call(call_sum_vec, &engines[i], args))
+    {
+      failures += report_fault(&engines[i], args->name, iter);
+    }
+    else if (memcmp(args->result, expected, bytes) != 0)
+    {
+      fprintf(stderr, "\t[%s] %s len %ld (iter %u): result mismatch\n", engines[i].name, args->name, args->len, iter);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+static unsigned diff_sum_vec (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  long int len      = rand_range(rng, 0, 100 /* several full vectors + tail */);
+  size_t bytes      = (size_t) len;
+  int flush_end     = iter & 1;
+
+  GuardBuf result_buf, x_buf, y_buf;
+  int8_t* x = guard_alloc(&x_buf, bytes, flush_end);
+  int8_t* y = guard_alloc(&y_buf, bytes, flush_end);
+
+  SumVecArgs args  = { "sum_vec", guard_alloc(&result_buf, bytes, flush_end), x, y, len };
+  int8_t* expected = malloc(bytes);
+
+  for (long int i = 0; i < len; i++)
+  {
+    x[i]        = (int8_t) rand_int(rng);
+    y[i]        = (int8_t) rand_int(rng);
+    expected[i] = sat8_ref(x[i], y[i]);
+  }
+
+  failures += check_sum_vec(engines, &args, expected, bytes, iter);
+
+  // Cleanup
+  free(expected);
+  guard_free(&y_buf);
+  guard_free(&x_buf);
+  guard_free(&result_buf);
+
+  return failures;
+}
+
+static uint16_t usat16_ref (
+  uint16_t x,
+  uint16_t y
+)
+{
+  unsigned sum = (unsigned) x + y;
+
+  return sum > UINT16_MAX ? UINT16_MAX : (uint16_t) sum;
+}
+
+// 8 x u16 lanes per 128 bit vector, unsigned saturation
+static unsigned diff_sum_usat16_vec (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  long int len      = rand_range(rng, 0, 50);
+  size_t bytes      = sizeof(uint16_t) * (size_t) len;
+  int flush_end     = iter & 1;
+
+  GuardBuf result_buf, x_buf, y_buf;
+  uint16_t* x = guard_alloc(&x_buf, bytes, flush_end);
+  uint16_t* y = guard_alloc(&y_buf, bytes, flush_end);
+
+  SumVecArgs args    = { "sum_usat16_vec", guard_alloc(&result_buf, bytes, flush_end), x, y, len };
+  uint16_t* expected = malloc(bytes);
+
+  for (long int i = 0; i < len; i++)
+  {
+    x[i]        = (uint16_t) rand_int(rng);
+    y[i]        = (uint16_t) rand_int(rng);
+    expected[i] = usat16_ref(x[i], y[i]);
+  }
+
+  failures += check_sum_vec(engines, &args, expected, bytes, iter);
+
+  // Cleanup
+  free(expected);
+  guard_free(&y_buf);
+  guard_free(&x_buf);
+  guard_free(&result_buf);
+
+  return failures;
+}
+
+// i17 wraps at 17 bits and is returned/stored sign extended
+static int sext17_ref (
+  int x,
+  int y
+)
+{
+  return (int) (((unsigned) x + (unsigned) y) << 15) >> 15;
+}
+
+static unsigned diff_sum_i17 (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  SumArgs args = { "sum_i17", 17, sext17_ref(rand_int(rng), 0), sext17_ref(rand_int(rng), 0), 0 };
+
+  return check_sum(engines, &args, sext17_ref(args.x, args.y), iter);
+}
+
+// i17 kept in i32 storage, 8 lanes per 256 bit vector
+static unsigned diff_sum_i17_vec (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  long int len      = rand_range(rng, 0, 50);
+  size_t bytes      = sizeof(int32_t) * (size_t) len;
+  int flush_end     = iter & 1;
+
+  GuardBuf result_buf, x_buf, y_buf;
+  int32_t* x = guard_alloc(&x_buf, bytes, flush_end);
+  int32_t* y = guard_alloc(&y_buf, bytes, flush_end);
+
+  SumVecArgs args   = { "sum_i17_vec", guard_alloc(&result_buf, bytes, flush_end), x, y, len };
+  int32_t* expected = malloc(bytes);
+
+  for (long int i = 0; i < len; i++)
+  {
+    x[i]        = rand_int(rng);
+    y[i]        = rand_int(rng);
+    expected[i] = sext17_ref(x[i], y[i]);
+  }
+
+  failures += check_sum_vec(engines, &args, expected, bytes, iter);
+
+  // Cleanup
+  free(expected);
+  guard_free(&y_buf);
+  guard_free(&x_buf);
+  guard_free(&result_buf);
+
+  return failures;
+}
+
+// Signed overflow must trap (SIGILL), anything else must return the plain sum
+static unsigned diff_sum_trap (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  SumArgs args  = { "sum_trap", 32, rand_int(rng), rand_int(rng), 0 };
+  int expected  = 0;
+  int overflows = __builtin_add_overflow(args.x, args.y, &expected);
+
+  return check_sum_trap(engines, &args, overflows, expected, iter);
+}
+
+// Unsigned carry must trap (SIGILL), returned zero extended so compared as raw bits
+static unsigned diff_sum_trap_u (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  SumArgs args      = { "sum_trap_u", 32, rand_int(rng), rand_int(rng), 0 };
+  unsigned expected = 0;
+  int overflows     = __builtin_add_overflow((unsigned) args.x, (unsigned) args.y, &expected);
+
+  return check_sum_trap(engines, &args, overflows, (int) expected, iter);
+}
+
+// 4 x i32 lanes per 128 bit vector, signed overflow in any lane (or the tail) must trap
+// - inputs are halved so most calls return, every other call gets one overflowing element
+static unsigned diff_sum_trap_vec (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  long int len      = rand_range(rng, 0, 50);
+  size_t bytes      = sizeof(int32_t) * (size_t) len;
+  int flush_end     = iter & 1;
+
+  GuardBuf result_buf, x_buf, y_buf;
+  int32_t* x = guard_alloc(&x_buf, bytes, flush_end);
+  int32_t* y = guard_alloc(&y_buf, bytes, flush_end);
+
+  SumVecArgs args   = { "sum_trap_vec", guard_alloc(&result_buf, bytes, flush_end), x, y, len };
+  int32_t* expected = malloc(bytes);
+
+  for (long int i = 0; i < len; i++)
+  {
+    x[i] = rand_int(rng) / 2;
+    y[i] = rand_int(rng) / 2;
+  }
+
+  int overflows = len > 0 && rng_next(rng) % 2;
+
+  if (overflows)
+  {
+    long int at = rand_range(rng, 0, (int) len - 1);
+
+    x[at] = INT32_MAX;
+    y[at] = rand_range(rng, 1, 100);
+  }
+
+  for (long int i = 0; i < len && !overflows; i++)
+  {
+    expected[i] = x[i] + y[i];
+  }
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], args.name)) continue;
+
+    memset(args.result, 0, bytes);
+
+    int sig = guarded_call(call_sum_vec, &engines[i], &args);
+
+    if (overflows && sig != SIGILL)
+    {
+      fprintf(stderr, "\t[%s] sum_trap_vec len %ld (iter %u): expected a trap, got %s\n", engines[i].name, len, iter, sig ? strsignal(sig) : "a return");
+      failures++;
+    }
+    else if (!overflows && sig)
+    {
+      fprintf(stderr, "\t[%s] sum_trap_vec len %ld (iter %u): unexpected %s\n", engines[i].name, len, iter, strsignal(sig));
+      failures++;
+    }
+    else if (!overflows && memcmp(args.result, expected, bytes) != 0)
+    {
+      fprintf(stderr, "\t[%s] sum_trap_vec len %ld (iter %u): result mismatch\n", engines[i].name, len, iter);
+      failures++;
+    }
+  }
+
+  // Cleanup
+  free(expected);
+  guard_free(&y_buf);
+  guard_free(&x_buf);
+  guard_free(&result_buf);
+
+  return failures;
+}
+
+static int fib_ref (
+  int x
+)
+{
+  int a = 1;
+  int b = 1;
+
+  for (int i = 3; i <= x; i++)
+  {
+    int c = a + b;
+    a     = b;
+    b     = c;
+  }
+
+  return b;
+}
+
+// Every add saturates, so the recursion is the same as saturating the iterative sum
+static int8_t fib_sat8_ref (
+  int x
+)
+{
+  int8_t a = 1;
+  int8_t b = 1;
+
+  for (int i = 3; i <= x; i++)
+  {
+    int8_t c = sat8_ref(a, b);
+    a        = b;
+    b        = c;
+  }
+
+  return b;
+}
+
+// Runs a fib style fn under every config, return value is compared against `expected`
+static unsigned check_fib (
+  DiffEngine engines[],
+  FibArgs* args,
+  int expected,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], args->name)) continue;
+
+    if (guarded_call(call_fib, &engines[i], args))
+    {
+      failures += report_fault(&engines[i], args->name, iter);
+    }
+    else if (args->ret != expected)
+    {
+      fprintf(stderr, "\t[%s] %s %d (iter %u): got %d, expected %d\n", engines[i].name, args->name, args->x, iter, args->ret, expected);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+static unsigned diff_fib (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  FibArgs args = { "fib", 32, rand_range(rng, -4, 20 /* recursive, keep interpreter time sane */), 0 };
+
+  return check_fib(engines, &args, fib_ref(args.x), iter);
+}
+
+// i8 saturates from fib(12) = 144 on
+static unsigned diff_fib_sat8 (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  FibArgs args = { "fib_sat8", 8, rand_range(rng, -4, 20), 0 };
+
+  return check_fib(engines, &args, fib_sat8_ref(args.x), iter);
+}
+
+static unsigned diff_loop (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  long int len      = rand_range(rng, 0, 64);
+  size_t bytes      = sizeof(double) * (size_t) len;
+  int flush_end     = iter & 1;
+
+  GuardBuf result_buf, x_buf, y_buf;
+  LoopArgs args = {
+    guard_alloc(&result_buf, bytes, flush_end),
+    guard_alloc(&x_buf,      bytes, flush_end),
+    guard_alloc(&y_buf,      bytes, flush_end),
+    len
+  };
+
+  double* expected = malloc(bytes);
+
+  for (long int i = 0; i < len; i++)
+  {
+    args.x[i]   = rand_dbl(rng);
+    args.y[i]   = rand_dbl(rng);
+    expected[i] = args.x[i] * args.y[i];
+  }
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], "loop")) continue;
+
+    memset(args.result, 0, bytes);
+
+    if (guarded_call(call_loop, &engines[i], &args))
+    {
+      failures += report_fault(&engines[i], "loop", iter);
+    }
+    else if (memcmp(args.result, expected, bytes) != 0)
+    {
+      fprintf(stderr, "\t[%s] loop len %ld (iter %u): result mismatch\n", engines[i].name, len, iter);
+      failures++;
+    }
+  }
+
+  // Cleanup
+  free(expected);
+  guard_free(&y_buf);
+  guard_free(&x_buf);
+  guard_free(&result_buf);
+
+  return failures;
+}
+
+static unsigned diff_get_snd_int (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+
+  GuardBuf buf;
+  SndIntArgs args = { guard_alloc(&buf, sizeof(int) * 2, iter & 1), 0 };
+
+  args.ints[0] = rand_int(rng);
+  args.ints[1] = rand_int(rng);
+
+  int expected = args.ints[1];
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], "get_snd_int")) continue;
+
+    if (guarded_call(call_get_snd_int, &engines[i], &args))
+    {
+      failures += report_fault(&engines[i], "get_snd_int", iter);
+    }
+    else if (args.ret != expected)
+    {
+      fprintf(stderr, "\t[%s] get_snd_int (iter %u): got %d, expected %d\n", engines[i].name, iter, args.ret, expected);
+      failures++;
+    }
+  }
+
+  guard_free(&buf);
+
+  return failures;
+}
+
+static unsigned diff_munge (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+
+  GuardBuf buf;
+  MungeArgs args = { guard_alloc(&buf, sizeof(Munger) * 3, iter & 1) };
+
+  Munger input[3];
+  Munger expected[3];
+
+  for (int i = 0; i < 3; i++)
+  {
+    input[i].f1 = rand_int(rng);
+    input[i].f2 = rand_int(rng);
+  }
+
+  // P[0].f1 = P[1].f1 + P[2].f2
+  memcpy(expected, input, sizeof(input));
+  expected[0].f1 = (int) ((unsigned) input[1].f1 + (unsigned) input[2].f2);
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], "munge")) continue;
+
+    memcpy(args.mungers, input, sizeof(input));
+
+    if (guarded_call(call_munge, &engines[i], &args))
+    {
+      failures += report_fault(&engines[i], "munge", iter);
+    }
+    else if (memcmp(args.mungers, expected, sizeof(expected)) != 0)
+    {
+      fprintf(stderr, "\t[%s] munge (iter %u): result mismatch\n", engines[i].name, iter);
+      failures++;
+    }
+  }
+
+  guard_free(&buf);
+
+  return failures;
+}
+
+// foo and st_z_b only compute addresses, compare against what the C compiler computes
+static unsigned diff_field_ptr (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+
+  GuardBuf buf;
+  FieldPtrArgs args = {
+    guard_alloc(&buf, sizeof(ST) * 4, iter & 1),
+    rand_range(rng, 0, 3),
+    rand_range(rng, 0, 9),
+    rand_range(rng, 0, 19),
+    NULL,
+    NULL
+  };
+
+  int* foo_expected    = &args.s[1].Z.B[5][13];
+  int* st_z_b_expected = &args.s[args.i].Z.B[args.j][args.k];
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], "foo") || skip_fn(&engines[i], "st_z_b")) continue;
+
+    if (guarded_call(call_field_ptr, &engines[i], &args))
+    {
+      failures += report_fault(&engines[i], "foo/st_z_b", iter);
+    }
+    else if (args.foo_ret != foo_expected || args.st_z_b_ret != st_z_b_expected)
+    {
+      fprintf(stderr, "\t[%s] foo/st_z_b %ld %ld %ld (iter %u): address mismatch\n", engines[i].name, args.i, args.j, args.k, iter);
+      failures++;
+    }
+  }
+
+  guard_free(&buf);
+
+  return failures;
+}
+
+// Random idx[] into base[base_len], `oob` extra values past the end for bounds checked fns
+static uint32_t* rand_idx (
+  GuardBuf* buf,
+  unsigned long long* rng,
+  long int len,
+  long int base_len,
+  int oob,
+  int flush_end
+)
+{
+  uint32_t* idx = guard_alloc(buf, sizeof(uint32_t) * (size_t) len, flush_end);
+
+  for (long int i = 0; i < len; i++)
+  {
+    idx[i] = (uint32_t) rand_range(rng, 0, (int) base_len - 1 + oob);
+  }
+
+  return idx;
+}
+
+// Runs a gather/scatter style fn under every config
+// - `checked` (the out or base buffer) is reset to `initial` before each call, or filled w/ 0xff when NULL so missed stores show
+// - after the call `checked` is compared against `expected`
+static unsigned check_indexed (
+  DiffEngine engines[],
+  IndexedArgs* args,
+  void* checked,
+  const void* initial,
+  const void* expected,
+  size_t bytes,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (skip_fn(&engines[i], args->name)) continue;
+
+    if (initial) memcpy(checked, initial, bytes);
+    else         memset(checked, 0xff, bytes);
+
+    if (guarded_call(call_indexed, &engines[i], args))
+    {
+      failures += report_fault(&engines[i], args->name, iter);
+    }
+    else if (memcmp(checked, expected, bytes) != 0)
+    {
+      fprintf(stderr, "\t[%s] %s len %ld base_len %ld (iter %u): result mismatch\n", engines[i].name, args->name, args->len, args->base_len, iter);
+      failures++;
+    }
+  }
+
+  return failures;
+}
+
+static unsigned diff_gather (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  long int len      = rand_range(rng, 0, 100);
+  long int base_len = rand_range(rng, 1, 64);
+  size_t bytes      = sizeof(int) * (size_t) len;
+  int flush_end     = iter & 1;
+
+  GuardBuf out_buf, base_buf, idx_buf;
+  int* out  = guard_alloc(&out_buf, bytes, flush_end);
+  int* base = guard_alloc(&base_buf, sizeof(int) * (size_t) base_len, flush_end);
+
+  IndexedArgs args = { "gather", out, base, rand_idx(&idx_buf, rng, len, base_len, 0, flush_end), len, base_len };
+  int* expected    = malloc(bytes);
+
+  for (long int i = 0; i < base_len; i++) base[i] = rand_int(rng);
+  for (long int i = 0; i < len; i++)      expected[i] = base[args.idx[i]];
+
+  failures += check_indexed(engines, &args, out, NULL, expected, bytes, iter);
+
+  // Cleanup
+  free(expected);
+  guard_free(&idx_buf);
+  guard_free(&base_buf);
+  guard_free(&out_buf);
+
+  return failures;
+}
+
+static unsigned diff_gather_munger_f2 (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  long int len      = rand_range(rng, 0, 100);
+  long int base_len = rand_range(rng, 1, 64);
+  size_t bytes      = sizeof(int) * (size_t) len;
+  int flush_end     = iter & 1;
+
+  GuardBuf out_buf, base_buf, idx_buf;
+  int* out     = guard_alloc(&out_buf, bytes, flush_end);
+  Munger* base = guard_alloc(&base_buf, sizeof(Munger) * (size_t) base_len, flush_end);
+
+  IndexedArgs args = { "gather_munger_f2", out, base, rand_idx(&idx_buf, rng, len, base_len, 8 /* oob */, flush_end), len, base_len };
+  int* expected    = malloc(bytes);
+
+  for (long int i = 0; i < base_len; i++)
+  {
+    base[i].f1 = rand_int(rng);
+    base[i].f2 = rand_int(rng);
+  }
+
+  for (long int i = 0; i < len; i++)
+  {
+    expected[i] = args.idx[i] < base_len ? base[args.idx[i]].f2 : 0;
+  }
+
+  failures += check_indexed(engines, &args, out, NULL, expected, bytes, iter);
+
+  // Cleanup
+  free(expected);
+  guard_free(&idx_buf);
+  guard_free(&base_buf);
+  guard_free(&out_buf);
+
+  return failures;
+}
+
+static unsigned diff_scatter (
+  DiffEngine engines[],
+  unsigned long long* rng,
+  unsigned iter
+)
+{
+  unsigned failures = 0;
+  long int len      = rand_range(rng, 0, 100);
+  long int base_len = rand_range(rng, 1, 64);
+  size_t base_bytes = sizeof(int) * (size_t) base_len;
+  int flush_end     = iter & 1;
+
+  GuardBuf base_buf, src_buf, idx_buf;
+  int* base = guard_alloc(&base_buf, base_bytes, flush_end);
+  int* src  = guard_alloc(&src_buf, sizeof(int) * (size_t) len, flush_end);
+
+  IndexedArgs args = { "scatter", base, src, rand_idx(&idx_buf, rng, len, base_len, 8 /* oob */, flush_end), len, base_len };
+  int* input       = malloc(base_bytes);
+  int* expected    = malloc(base_bytes);
+
+  for (long int i = 0; i < base_len; i++) input[i] = rand_int(rng);
+  for (long int i = 0; i < len; i++)      src[i]   = rand_int(rng);
+
+  // Sequential semantics, later writes to the same idx win
+  memcpy(expected, input, base_bytes);
+
+  for (long int i = 0; i < len; i++)
+  {
+    if (args.idx[i] < base_len) expected[args.idx[i]] = src[i];
+  }
+
+  failures += check_indexed(engines, &args, base, input, expected, base_bytes, iter);
+
+  // Cleanup
+  free(expected);
+  free(input);
+  guard_free(&idx_buf);
+  guard_free(&src_buf);
+  guard_free(&base_buf);
+
+  return failures;
+}
+
+unsigned run_diff_tests (
+  LLVMModuleRef mod,
+  unsigned iterations,
+  unsigned long long seed
+)
+{
+  unsigned failures        = 0;
+  unsigned long long state = seed ? seed : 0x9E3779B97F4A7C15ULL; // xorshift state must be non-zero
+
+  // Build an engine per config
+  DiffEngine engines[DIFF_NUM_CONFIGS];
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    if (create_engine(&engines[i], mod, (DiffConfig) i))
+    {
+      while (i--) LLVMDisposeExecutionEngine(engines[i].engine);
+      return 1;
+    }
+  }
+
+  // Catch out-of-bounds accesses and traps
+  struct sigaction action, old_segv, old_bus, old_ill;
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = on_fault;
+  sigemptyset(&action.sa_mask);
+
+  sigaction(SIGSEGV, &action, &old_segv);
+  sigaction(SIGBUS,  &action, &old_bus);
+  sigaction(SIGILL,  &action, &old_ill);
+
+  // Run
+  printf("\n--- diff tests (seed %llu, %u iterations) ---\n", seed, iterations);
+
+  for (unsigned iter = 0; iter < iterations; iter++)
+  {
+    failures += diff_sum(engines, &state, iter);
+    failures += diff_sum_nsw(engines, &state, iter);
+    failures += diff_sum_nuw(engines, &state, iter);
+    failures += diff_sum_sat8(engines, &state, iter);
+    failures += diff_sum_vec(engines, &state, iter);
+    failures += diff_sum_usat16_vec(engines, &state, iter);
+    failures += diff_sum_i17(engines, &state, iter);
+    failures += diff_sum_i17_vec(engines, &state, iter);
+    failures += diff_sum_trap(engines, &state, iter);
+    failures += diff_sum_trap_u(engines, &state, iter);
+    failures += diff_sum_trap_vec(engines, &state, iter);
+    failures += diff_fib(engines, &state, iter);
+    failures += diff_fib_sat8(engines, &state, iter);
+    failures += diff_loop(engines, &state, iter);
+    failures += diff_get_snd_int(engines, &state, iter);
+    failures += diff_munge(engines, &state, iter);
+    failures += diff_gather(engines, &state, iter);
+    failures += diff_gather_munger_f2(engines, &state, iter);
+    failures += diff_scatter(engines, &state, iter);
+    failures += diff_field_ptr(engines, &state, iter);
+  }
+
+  printf("\tfailures: %u\n", failures);
+
+  for (int config = 0; config < DIFF_NUM_CONFIGS; config++)
+  {
+    int any = F;
+
+    for (unsigned i = 0; i < num_skipped; i++)
+    {
+      if (skipped[i].config != config) continue;
+
+      if (any) printf(", %s", skipped[i].fn);
+      else     printf("\tskipped under %s (calls intrinsics): %s", config_names[config], skipped[i].fn);
+
+      any = T;
+    }
+
+    if (any) printf("\n");
+  }
+
+  printf("----------------------\n");
+
+  // Cleanup
+  sigaction(SIGILL,  &old_ill,  NULL);
+  sigaction(SIGBUS,  &old_bus,  NULL);
+  sigaction(SIGSEGV, &old_segv, NULL);
+
+  for (int i = 0; i < DIFF_NUM_CONFIGS; i++)
+  {
+    LLVMDisposeExecutionEngine(engines[i].engine);
+  }
+
+  return failures;
+}
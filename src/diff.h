@@ -0,0 +1,20 @@
+#include <llvm-c/Core.h>
+
+// Execution configs every generated fn is run under
+typedef enum {
+  DIFF_INTERP,    // LLVM interpreter
+  DIFF_MCJIT_O0,  // MCJIT, unoptimized
+  DIFF_MCJIT_O3,  // MCJIT, -O3 IR pipeline + aggressive codegen
+  DIFF_NUM_CONFIGS
+} DiffConfig;
+
+// Runs `sum`, `sum_nsw`, `sum_nuw`, `sum_sat8`, `sum_vec`, `sum_usat16_vec`, `sum_i17`, `sum_i17_vec`, `sum_trap`, `sum_trap_u`, `sum_trap_vec`, `fib`, `fib_sat8`, `loop`, `get_snd_int`, `munge`, `gather`, `gather_munger_f2`, `scatter`, `foo` and `st_z_b` from `mod` under every DiffConfig
+// - `mod` is cloned per config and left untouched
+// - fns that call intrinsics skip DIFF_INTERP (it can't lower them), the skipped (fn, config) pairs are printed in the summary
+// - inputs/lengths are randomized from `seed`, buffers are surrounded by guard pages
+// - returns number of failed checks (mismatch, wrong result or out-of-bounds access)
+unsigned run_diff_tests (
+  LLVMModuleRef mod,
+  unsigned iterations,
+  unsigned long long seed
+);
@@ -0,0 +1,415 @@
+// Bounded memory for long running JITs
+//
+// Every unit (a group of fns built by one generator) gets its own ctx, module and MCJIT engine:
+// - disposing all three is the only way to hand memory back, types/constants live as long as their ctx
+// - once code is finalized the IR isn't needed to run it: module is removed from the engine and ctx disposed
+// - code/data sections are allocated by our own memory manager, so native bytes per unit are exact
+// - least recently used units are evicted when the total goes over cap_bytes, and recompiled on next use
+//   - cap is enforced right after codegen while the new unit's IR is still alive, so room is made for IR + code
+//   - sizes aren't known before compiling, the peak can go over cap by whatever the new unit needs
+//   - pinned units are never evicted, callers pin a unit while holding on to its fn addresses
+// - IR is measured as bitcode size, in-memory IR (module + ctx) is several times bigger
+
+#include "engine.h"
+#include "util.h"
+
+#include <llvm-c/Analysis.h>
+#include <llvm-c/BitWriter.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Address space reserved per unit, sections are carved out of it
+// - keeps every section of a unit within 32 bit relocation range of the others
+// - only reserved (PROT_NONE), pages are committed as sections are allocated
+#define ENGINE_REGION_BYTES (64u << 20)
+
+typedef struct {
+  uint8_t* ptr;    // Page aligned
+  size_t len;      // Page rounded
+  int is_code;
+  int is_readonly;
+} EngineSection;
+
+struct EngineUnit {
+  const char* name;
+  EngineGenFn gen;
+  void* arg;
+
+  // Resident state, NULL/0 when evicted
+  LLVMContextRef ctx;            // Only while compiling, disposed w/ the IR
+  LLVMExecutionEngineRef engine;
+  uint8_t* region;
+  size_t region_used;
+  EngineSection* sections;
+  unsigned num_sections;
+  EngineUsage usage;
+  unsigned long long last_used;
+  unsigned num_pins;             // Not evicted while > 0
+
+  // Stats
+  unsigned num_compiles;
+  JitPlan last_plan;
+};
+
+//--- Memory manager ---
+// - each section gets its own pages (so they can be protected separately), carved from the unit's region
+
+static uint8_t* alloc_section (
+  EngineUnit* unit,
+  uintptr_t size,
+  unsigned alignment,
+  int is_code,
+  int is_readonly
+)
+{
+  size_t page_size = (size_t) sysconf(_SC_PAGESIZE);
+  size_t align     = alignment > page_size ? alignment : page_size;
+  size_t len       = size ? (size + page_size - 1) / page_size * page_size : page_size;
+
+  if (!unit->region)
+  {
+    void* region = mmap(NULL, ENGINE_REGION_BYTES, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (region == MAP_FAILED) return NULL;
+
+    unit->region      = region;
+    unit->region_used = 0;
+  }
+
+  uintptr_t start = ((uintptr_t) unit->region + unit->region_used + align - 1) & ~((uintptr_t) align - 1);
+  size_t offset   = start - (uintptr_t) unit->region;
+
+  if (offset + len > ENGINE_REGION_BYTES)
+  {
+    fprintf(stderr, "%s: sections exceed the %u byte region\n", unit->name, ENGINE_REGION_BYTES);
+    return NULL;
+  }
+
+  uint8_t* ptr = (uint8_t*) start;
+  if (mprotect(ptr, len, PROT_READ | PROT_WRITE) != 0) return NULL;
+
+  unit->region_used = offset + len;
+
+  unit->sections = realloc(unit->sections, sizeof(EngineSection) * (unit->num_sections + 1));
+  unit->sections[unit->num_sections++] = (EngineSection) { ptr, len, is_code, is_readonly };
+
+  if (is_code) unit->usage.code_bytes += len;
+  else         unit->usage.data_bytes += len;
+
+  return ptr;
+}
+
+static uint8_t* alloc_code_section (
+  void* opaque,
+  uintptr_t size,
+  unsigned alignment,
+  unsigned section_id,
+  const char* section_name
+)
+{
+  return alloc_section(opaque, size, alignment, T, T);
+}
+
+static uint8_t* alloc_data_section (
+  void* opaque,
+  uintptr_t size,
+  unsigned alignment,
+  unsigned section_id,
+  const char* section_name,
+  LLVMBool is_readonly
+)
+{
+  return alloc_section(opaque, size, alignment, F, is_readonly);
+}
+
+// Relocations are applied, drop write access
+static LLVMBool finalize_sections (
+  void* opaque,
+  char** err
+)
+{
+  EngineUnit* unit = opaque;
+
+  for (unsigned i = 0; i < unit->num_sections; i++)
+  {
+    EngineSection* s = &unit->sections[i];
+    int prot         = s->is_code ? PROT_READ | PROT_EXEC : s->is_readonly ? PROT_READ : PROT_READ | PROT_WRITE;
+
+    if (mprotect(s->ptr, s->len, prot) != 0)
+    {
+      *err = strdup("mprotect failed");
+      return T;
+    }
+  }
+
+  return F;
+}
+
+// Called when the engine is disposed
+static void destroy_sections (
+  void* opaque
+)
+{
+  EngineUnit* unit = opaque;
+
+  if (unit->region) munmap(unit->region, ENGINE_REGION_BYTES);
+  free(unit->sections);
+
+  unit->region           = NULL;
+  unit->region_used      = 0;
+  unit->sections         = NULL;
+  unit->num_sections     = 0;
+  unit->usage.code_bytes = 0;
+  unit->usage.data_bytes = 0;
+}
+
+//--- Units ---
+
+static unsigned long long usage_bytes (
+  EngineUsage usage
+)
+{
+  return usage.ir_bytes + usage.code_bytes + usage.data_bytes;
+}
+
+static void evict (
+  EngineManager* mgr,
+  EngineUnit* unit
+)
+{
+  LLVMDisposeExecutionEngine(unit->engine); // Also destroys sections
+  if (unit->ctx) LLVMContextDispose(unit->ctx);
+
+  unit->engine         = NULL;
+  unit->ctx            = NULL;
+  unit->usage.ir_bytes = 0;
+
+  mgr->num_evictions++;
+}
+
+// Evict least recently used unpinned units (other than `keep`) until under cap
+static void enforce_cap (
+  EngineManager* mgr,
+  EngineUnit* keep
+)
+{
+  while (usage_bytes(engine_manager_total_usage(mgr)) > mgr->cap_bytes)
+  {
+    EngineUnit* lru = NULL;
+
+    for (unsigned i = 0; i < mgr->num_units; i++)
+    {
+      EngineUnit* unit = mgr->units[i];
+
+      if (unit == keep || !unit->engine || unit->num_pins) continue;
+      if (!lru || unit->last_used < lru->last_used) lru = unit;
+    }
+
+    if (!lru) return; // `keep` and pinned units alone are over cap, nothing left to evict
+
+    evict(mgr, lru);
+  }
+}
+
+static void track_peak (
+  EngineManager* mgr
+)
+{
+  unsigned long long total = usage_bytes(engine_manager_total_usage(mgr));
+
+  if (total > mgr->peak_bytes) mgr->peak_bytes = total;
+}
+
+static int compile (
+  EngineManager* mgr,
+  EngineUnit* unit
+)
+{
+  // Generate
+  unit->ctx         = LLVMContextCreate();
+  LLVMModuleRef mod = LLVMModuleCreateWithNameInContext(unit->name, unit->ctx);
+
+  unit->gen(unit->ctx, mod, unit->arg);
+
+  LLVMVerifyModule(mod, LLVMAbortProcessAction, NULL);
+
+  // Bitcode size as a proxy for IR (module + ctx) memory while it is resident
+  LLVMMemoryBufferRef bitcode = LLVMWriteBitcodeToMemoryBuffer(mod);
+  unit->usage.ir_bytes        = LLVMGetBufferSize(bitcode);
+  LLVMDisposeMemoryBuffer(bitcode);
+
+  // Compile w/ our memory manager
+  LLVMMCJITMemoryManagerRef mm = LLVMCreateSimpleMCJITMemoryManager(unit, alloc_code_section, alloc_data_section, finalize_sections, destroy_sections);
+
+  if (jit_compile(&mgr->tuner, mod, mgr->budget_ms, mm, &unit->engine, &unit->last_plan) != 0)
+  {
+    LLVMContextDispose(unit->ctx);
+
+    unit->engine         = NULL;
+    unit->ctx            = NULL;
+    unit->usage.ir_bytes = 0;
+
+    return 1;
+  }
+
+  unit->num_compiles++;
+  mgr->num_compiles++;
+
+  // IR and code are both alive, that's the peak. Make room while IR still counts
+  track_peak(mgr);
+  enforce_cap(mgr, unit);
+
+  // Code is final, IR can go. Fns stay callable, the engine only needs the emitted code
+  LLVMModuleRef removed = NULL;
+  char* err             = NULL;
+
+  if (!LLVMRemoveModule(unit->engine, mod, &removed, &err))
+  {
+    LLVMDisposeModule(removed);
+    LLVMContextDispose(unit->ctx);
+
+    unit->ctx            = NULL;
+    unit->usage.ir_bytes = 0;
+  }
+
+  LLVMDisposeMessage(err);
+
+  return 0;
+}
+
+//--- Manager ---
+
+void engine_manager_init (
+  EngineManager* mgr,
+  unsigned long long cap_bytes,
+  double budget_ms
+)
+{
+  mgr->units         = NULL;
+  mgr->num_units     = 0;
+  mgr->cap_bytes     = cap_bytes;
+  mgr->tick          = 0;
+  mgr->budget_ms     = budget_ms;
+  mgr->num_compiles  = 0;
+  mgr->num_evictions = 0;
+  mgr->peak_bytes    = 0;
+
+  jit_tuner_init(&mgr->tuner);
+}
+
+int engine_manager_add (
+  EngineManager* mgr,
+  const char* name,
+  EngineGenFn gen,
+  void* arg
+)
+{
+  EngineUnit* unit = calloc(1, sizeof(EngineUnit));
+
+  unit->name = name;
+  unit->gen  = gen;
+  unit->arg  = arg;
+
+  mgr->units                   = realloc(mgr->units, sizeof(EngineUnit*) * (mgr->num_units + 1));
+  mgr->units[mgr->num_units++] = unit;
+
+  return (int) mgr->num_units - 1;
+}
+
+void* engine_manager_get (
+  EngineManager* mgr,
+  int unit_id,
+  const char* fn_name
+)
+{
+  EngineUnit* unit = mgr->units[unit_id];
+
+  if (!unit->engine)
+  {
+    if (compile(mgr, unit) != 0) return NULL;
+  }
+
+  unit->last_used = ++mgr->tick;
+
+  return (void*) LLVMGetFunctionAddress(unit->engine, fn_name);
+}
+
+void engine_manager_pin (
+  EngineManager* mgr,
+  int unit_id
+)
+{
+  mgr->units[unit_id]->num_pins++;
+}
+
+void engine_manager_unpin (
+  EngineManager* mgr,
+  int unit_id
+)
+{
+  EngineUnit* unit = mgr->units[unit_id];
+
+  if (unit->num_pins && --unit->num_pins == 0) enforce_cap(mgr, NULL); // May have been kept over cap
+}
+
+EngineUsage engine_manager_usage (
+  const EngineManager* mgr,
+  int unit_id
+)
+{
+  return mgr->units[unit_id]->usage;
+}
+
+EngineUsage engine_manager_total_usage (
+  const EngineManager* mgr
+)
+{
+  EngineUsage total = { 0, 0, 0 };
+
+  for (unsigned i = 0; i < mgr->num_units; i++)
+  {
+    total.ir_bytes   += mgr->units[i]->usage.ir_bytes;
+    total.code_bytes += mgr->units[i]->usage.code_bytes;
+    total.data_bytes += mgr->units[i]->usage.data_bytes;
+  }
+
+  return total;
+}
+
+void engine_manager_print (
+  const EngineManager* mgr
+)
+{
+  EngineUsage total = engine_manager_total_usage(mgr);
+
+  printf("\t%-12s %-9s %8s %8s %8s %9s\n", "unit", "state", "ir(bc)", "code", "data", "compiles");
+
+  for (unsigned i = 0; i < mgr->num_units; i++)
+  {
+    EngineUnit* unit = mgr->units[i];
+
+    printf("\t%-12s %-9s %8llu %8llu %8llu %9u\n", unit->name, !unit->engine ? "evicted" : unit->num_pins ? "pinned" : "resident", unit->usage.ir_bytes, unit->usage.code_bytes, unit->usage.data_bytes, unit->num_compiles);
+  }
+
+  printf("\ttotal: %llu / %llu bytes (peak %llu w/ IR as bitcode), %u compiles, %u evictions\n", usage_bytes(total), mgr->cap_bytes, mgr->peak_bytes, mgr->num_compiles, mgr->num_evictions);
+}
+
+void engine_manager_dispose (
+  EngineManager* mgr
+)
+{
+  for (unsigned i = 0; i < mgr->num_units; i++)
+  {
+    if (mgr->units[i]->engine) evict(mgr, mgr->units[i]);
+
+    free(mgr->units[i]);
+  }
+
+  free(mgr->units);
+
+  mgr->units     = NULL;
+  mgr->num_units = 0;
+}
@@ -0,0 +1,91 @@
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <llvm-c/Core.h>
+#include <llvm-c/ExecutionEngine.h>
+
+#include "jit.h"
+
+// Builds a unit's fns into `mod`, called again whenever an evicted unit is used
+typedef void (*EngineGenFn) (LLVMContextRef ctx, LLVMModuleRef mod, void* arg);
+
+// Memory held by a unit (or all units)
+typedef struct {
+  unsigned long long ir_bytes;   // Bitcode size of the generated module, 0 once IR is dropped after codegen. Understates in-memory IR (module + ctx) several times over
+  unsigned long long code_bytes; // mapped executable sections
+  unsigned long long data_bytes; // mapped data sections (rw + ro)
+} EngineUsage;
+
+typedef struct EngineUnit EngineUnit;
+
+// Owns one ctx + module + MCJIT engine per unit
+// - compiled lazily on first use, least recently used units are evicted (engine, ctx, code freed) to stay under cap_bytes
+// - cap is checked right after codegen while the new unit's IR is still alive, the IR is dropped after that
+// - evicted units recompile transparently, opt levels picked by `tuner` within budget_ms
+// - pinned units are never evicted, the total can stay over cap until the last pin is dropped
+typedef struct {
+  EngineUnit** units;
+  unsigned num_units;
+  unsigned long long cap_bytes;
+  unsigned long long tick;
+  double budget_ms;
+  JitTuner tuner;
+
+  // Stats
+  unsigned num_compiles;
+  unsigned num_evictions;
+  unsigned long long peak_bytes; // Highest total seen, incl. IR of a unit being compiled
+} EngineManager;
+
+void engine_manager_init (
+  EngineManager* mgr,
+  unsigned long long cap_bytes,
+  double budget_ms
+);
+
+// Returns unit id, nothing is compiled yet
+int engine_manager_add (
+  EngineManager* mgr,
+  const char* name,
+  EngineGenFn gen,
+  void* arg
+);
+
+// Address of `fn_name` in `unit`, compiling it (and evicting others) when needed
+// - addresses of other units are only valid until the next engine_manager_get, unless their unit is pinned
+void* engine_manager_get (
+  EngineManager* mgr,
+  int unit,
+  const char* fn_name
+);
+
+// Keep `unit` resident (its addresses valid) across other engine_manager_get calls until unpinned, pins nest
+// - pinning an evicted unit takes effect once it is compiled by the next engine_manager_get
+void engine_manager_pin (
+  EngineManager* mgr,
+  int unit
+);
+
+void engine_manager_unpin (
+  EngineManager* mgr,
+  int unit
+);
+
+EngineUsage engine_manager_usage (
+  const EngineManager* mgr,
+  int unit
+);
+
+EngineUsage engine_manager_total_usage (
+  const EngineManager* mgr
+);
+
+void engine_manager_print (
+  const EngineManager* mgr
+);
+
+void engine_manager_dispose (
+  EngineManager* mgr
+);
+
+#endif
@@ -5,6 +5,8 @@
 //    if (x <= 2) return 1;
 //    return fib(x - 1) + fib(x - 2);
 //  }
+//
+// - overflow behavior of the add per IntMode, see arith.c
 
 #include "fib.h"
 #include "util.h"
@@ -13,7 +15,8 @@ LLVMValueRef create_fib_fn (
   LLVMContextRef ctx,
   LLVMModuleRef mod,
   const char* name,
-  unsigned num_bits
+  unsigned num_bits,
+  IntMode mode
 )
 {
   // Types
@@ -27,6 +30,7 @@ LLVMValueRef create_fib_fn (
   LLVMValueRef fn           = LLVMAddFunction(mod, name, signature);
 
   LLVMSetLinkage(fn, LLVMExternalLinkage);
+  set_int_ret_ext(ctx, fn, num_bits, mode);
 
   //
   LLVMValueRef one = LLVMConstInt(int_type, 1, F);
@@ -106,8 +110,10 @@ LLVMValueRef create_fib_fn (
   LLVMSetTailCall(fib_x_min_2, T);
 
   //
-  LLVMValueRef sum = LLVMBuildAdd(
+  LLVMValueRef sum = build_int_add(
     builder,
+    mod,
+    mode,
     fib_x_min_1,
     fib_x_min_2,
     ""
@@ -1,8 +1,11 @@
 #include <llvm-c/Core.h>
 
+#include "arith.h"
+
 LLVMValueRef create_fib_fn (
   LLVMContextRef ctx,
   LLVMModuleRef mod,
   const char* name,
-  unsigned num_bits
+  unsigned num_bits,
+  IntMode mode
 );
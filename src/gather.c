@@ -0,0 +1,403 @@
+// LLVM for c-like language w/ fns:
+//
+//  void gather (T* out, Elem* base, uint32_t* idx, size_t length, size_t base_len)
+//  {
+//    for (size_t i = 0; i < length; i++)
+//    {
+//      out[i] = base[idx[i]];
+//    }
+//  }
+//
+//  void scatter (Elem* base, T* src, uint32_t* idx, size_t length, size_t base_len)
+//  {
+//    for (size_t i = 0; i < length; i++)
+//    {
+//      base[idx[i]] = src[i];
+//    }
+//  }
+//
+// Unlike get_snd_int and munge (gep.c) the GEP indices are only known at runtime:
+// - a GEP w/ a vector of indices yields a vector of pointers
+//     %ptrs = getelementptr %Elem, %Elem* %base, <8 x i64> %idx, i32 <field>
+//   which llvm.masked.gather/scatter consume, lowered to vpgather/vpscatter w/ AVX2/AVX-512 (scalarized w/o)
+// - vector loop does `vector_width` elements at a time, scalar loop does the tail
+// - prefetching base[idx[i + d]] overlaps the cache misses of random access
+// - bounds checked: lanes/iterations w/ idx >= base_len are masked off
+
+#include <llvm-c/Target.h>
+
+#include "gather.h"
+#include "intrinsic.h"
+#include "util.h"
+
+typedef struct {
+  LLVMContextRef ctx;
+  LLVMModuleRef mod;
+  LLVMBuilderRef builder;
+  LLVMTypeRef elem_type;   // Type base points to
+  LLVMTypeRef val_type;    // Type gathered/scattered, elem or one of its fields
+  LLVMTypeRef int32_type;
+  LLVMTypeRef int64_type;
+  int field;
+  GatherOpts opts;
+  int is_scatter;
+
+  // Params
+  LLVMValueRef arg_base;
+  LLVMValueRef arg_vals;   // out for gather, src for scatter
+  LLVMValueRef arg_idx;
+  LLVMValueRef arg_len;
+  LLVMValueRef arg_base_len;
+} IndexedFn;
+
+// &base[k] or &base[k].field, k is i64 or <N x i64>
+static LLVMValueRef build_elem_ptr (
+  IndexedFn* f,
+  LLVMValueRef k
+)
+{
+  LLVMValueRef indexes[] = { k, LLVMConstInt(f->int32_type, f->field, F) };
+  int num_indexes        = f->field < 0 ? 1 : 2;
+
+  return LLVMBuildGEP2(f->builder, f->elem_type, f->arg_base, indexes, num_indexes, "");
+}
+
+// Zero extended idx[i]
+static LLVMValueRef build_load_idx (
+  IndexedFn* f,
+  LLVMValueRef i
+)
+{
+  LLVMValueRef idx_addr = LLVMBuildGEP2(f->builder, f->int32_type, f->arg_idx, &i, 1, "");
+  LLVMValueRef idx      = LLVMBuildLoad2(f->builder, f->int32_type, idx_addr, "");
+
+  return LLVMBuildZExt(f->builder, idx, f->int64_type, "k");
+}
+
+// Prefetch base[idx[i + dist]], clamped to idx[i] past the end (prefetch itself never faults)
+static void build_prefetch (
+  IndexedFn* f,
+  LLVMValueRef i,
+  unsigned lane
+)
+{
+  LLVMBuilderRef builder = f->builder;
+  LLVMTypeRef i8_ptr     = LLVMPointerType(LLVMInt8TypeInContext(f->ctx), 0 /* AddressSpace */);
+
+  LLVMValueRef ahead    = LLVMBuildAdd(builder, i, LLVMConstInt(f->int64_type, f->opts.prefetch_dist + lane, F), "");
+  LLVMValueRef in_range = LLVMBuildICmp(builder, LLVMIntULT, ahead, f->arg_len, "");
+  LLVMValueRef j        = LLVMBuildSelect(builder, in_range, ahead, i, "");
+  LLVMValueRef ptr      = LLVMBuildBitCast(builder, build_elem_ptr(f, build_load_idx(f, j)), i8_ptr, "");
+
+  LLVMTypeRef signature;
+  LLVMValueRef prefetch_fn = get_intrinsic(f->mod, "llvm.prefetch", &i8_ptr, 1, &signature);
+  LLVMValueRef args[]      = {
+    ptr,
+    LLVMConstInt(f->int32_type, f->is_scatter ? 1 : 0, F), // rw: read/write
+    LLVMConstInt(f->int32_type, 3, F),                     // locality: keep in all cache levels
+    LLVMConstInt(f->int32_type, 1, F)                      // cache type: data
+  };
+
+  LLVMBuildCall2(builder, signature, prefetch_fn, args, LEN(args), "");
+}
+
+// Vector body
+//   represents: out[i:i+N] = base[idx[i:i+N]] or base[idx[i:i+N]] = src[i:i+N]
+static void build_vector_access (
+  IndexedFn* f,
+  LLVMValueRef i
+)
+{
+  LLVMBuilderRef builder = f->builder;
+  unsigned num_lanes     = f->opts.vector_width;
+  unsigned align         = LLVMABIAlignmentOfType(LLVMGetModuleDataLayout(f->mod), f->val_type);
+
+  // Types
+  LLVMTypeRef idx_vec_type = LLVMVectorType(f->int32_type, num_lanes);
+  LLVMTypeRef k_vec_type   = LLVMVectorType(f->int64_type, num_lanes);
+  LLVMTypeRef val_vec_type = LLVMVectorType(f->val_type, num_lanes);
+  LLVMTypeRef ptr_vec_type = LLVMVectorType(LLVMPointerType(f->val_type, 0 /* AddressSpace */), num_lanes);
+  LLVMTypeRef mask_type    = LLVMVectorType(LLVMInt1TypeInContext(f->ctx), num_lanes);
+
+  // idx[i:i+N]
+  LLVMValueRef idx_addr = LLVMBuildGEP2(builder, f->int32_type, f->arg_idx, &i, 1, "");
+  LLVMValueRef idx_vptr = LLVMBuildBitCast(builder, idx_addr, LLVMPointerType(idx_vec_type, 0), "");
+  LLVMValueRef idx_v    = LLVMBuildLoad2(builder, idx_vec_type, idx_vptr, "");
+
+  LLVMSetAlignment(idx_v, 4);
+
+  LLVMValueRef k_v  = LLVMBuildZExt(builder, idx_v, k_vec_type, "k");
+  LLVMValueRef ptrs = build_elem_ptr(f, k_v);
+
+  // Mask: all lanes, or lanes in bounds
+  LLVMValueRef mask = LLVMConstAllOnes(mask_type);
+
+  if (f->opts.bounds_checked)
+  {
+    LLVMValueRef len_v = LLVMBuildInsertElement(builder, LLVMGetUndef(k_vec_type), f->arg_base_len, LLVMConstInt(f->int32_type, 0, F), "");
+    len_v              = LLVMBuildShuffleVector(builder, len_v, LLVMGetUndef(k_vec_type), LLVMConstNull(LLVMVectorType(f->int32_type, num_lanes)), "");
+    mask               = LLVMBuildICmp(builder, LLVMIntULT, k_v, len_v, "in_bounds");
+  }
+
+  // out/src[i:i+N]
+  LLVMValueRef vals_addr = LLVMBuildGEP2(builder, f->val_type, f->arg_vals, &i, 1, "");
+  LLVMValueRef vals_vptr = LLVMBuildBitCast(builder, vals_addr, LLVMPointerType(val_vec_type, 0), "");
+  LLVMValueRef align_v   = LLVMConstInt(f->int32_type, align, F);
+
+  LLVMTypeRef signature;
+  LLVMTypeRef overloads[] = { val_vec_type, ptr_vec_type };
+
+  if (f->is_scatter)
+  {
+    LLVMValueRef src_v = LLVMBuildLoad2(builder, val_vec_type, vals_vptr, "");
+    LLVMSetAlignment(src_v, align);
+
+    LLVMValueRef scatter_fn = get_intrinsic(f->mod, "llvm.masked.scatter", overloads, 2, &signature);
+    LLVMValueRef args[]     = { src_v, ptrs, align_v, mask };
+
+    LLVMBuildCall2(builder, signature, scatter_fn, args, LEN(args), "");
+  }
+  else
+  {
+    LLVMValueRef gather_fn = get_intrinsic(f->mod, "llvm.masked.gather", overloads, 2, &signature);
+    LLVMValueRef args[]    = { ptrs, align_v, mask, LLVMConstNull(val_vec_type) /* masked off lanes */ };
+    LLVMValueRef out_v     = LLVMBuildCall2(builder, signature, gather_fn, args, LEN(args), "");
+
+    LLVMSetAlignment(LLVMBuildStore(builder, out_v, vals_vptr), align);
+  }
+}
+
+// Scalar body
+//   represents: out[i] = base[idx[i]] or base[idx[i]] = src[i], w/ optional bounds check
+static void build_scalar_access (
+  IndexedFn* f,
+  LLVMValueRef fn,
+  LLVMValueRef i
+)
+{
+  LLVMBuilderRef builder = f->builder;
+  LLVMValueRef k         = build_load_idx(f, i);
+  LLVMValueRef vals_addr = LLVMBuildGEP2(builder, f->val_type, f->arg_vals, &i, 1, "");
+
+  LLVMBasicBlockRef next = NULL;
+
+  // if (k < base_len) ... else out[i] = 0
+  if (f->opts.bounds_checked)
+  {
+    LLVMBasicBlockRef in_bounds     = LLVMAppendBasicBlockInContext(f->ctx, fn, "in_bounds");
+    LLVMBasicBlockRef out_of_bounds = LLVMAppendBasicBlockInContext(f->ctx, fn, "out_of_bounds");
+    next                            = LLVMAppendBasicBlockInContext(f->ctx, fn, "next");
+
+    LLVMValueRef cond = LLVMBuildICmp(builder, LLVMIntULT, k, f->arg_base_len, "");
+    LLVMBuildCondBr(builder, cond, in_bounds, out_of_bounds);
+
+    LLVMPositionBuilderAtEnd(builder, out_of_bounds);
+
+    if (!f->is_scatter) LLVMBuildStore(builder, LLVMConstNull(f->val_type), vals_addr);
+
+    LLVMBuildBr(builder, next);
+    LLVMPositionBuilderAtEnd(builder, in_bounds);
+  }
+
+  // Access
+  LLVMValueRef elem_addr = build_elem_ptr(f, k);
+
+  if (f->is_scatter)
+  {
+    LLVMBuildStore(builder, LLVMBuildLoad2(builder, f->val_type, vals_addr, ""), elem_addr);
+  }
+  else
+  {
+    LLVMBuildStore(builder, LLVMBuildLoad2(builder, f->val_type, elem_addr, ""), vals_addr);
+  }
+
+  if (next)
+  {
+    LLVMBuildBr(builder, next);
+    LLVMPositionBuilderAtEnd(builder, next);
+  }
+}
+
+static int is_vector_elem_type (
+  LLVMTypeRef type
+)
+{
+  switch (LLVMGetTypeKind(type))
+  {
+    case LLVMIntegerTypeKind:
+    case LLVMHalfTypeKind:
+    case LLVMFloatTypeKind:
+    case LLVMDoubleTypeKind:
+    case LLVMPointerTypeKind:
+      return T;
+
+    default:
+      return F;
+  }
+}
+
+static LLVMValueRef create_indexed_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name,
+  LLVMTypeRef elem_type,
+  int field,
+  GatherOpts opts,
+  int is_scatter
+)
+{
+  IndexedFn f = { ctx, mod, NULL, elem_type, elem_type, NULL, NULL, field, opts, is_scatter };
+
+  // Types
+  f.int32_type = LLVMInt32TypeInContext(ctx);
+  f.int64_type = LLVMInt64TypeInContext(ctx);
+
+  if (field >= 0) f.val_type = LLVMStructGetTypeAtIndex(elem_type, field);
+
+  LLVMTypeRef elem_ptr_type = LLVMPointerType(elem_type, 0 /* AddressSpace */);
+  LLVMTypeRef val_ptr_type  = LLVMPointerType(f.val_type, 0 /* AddressSpace */);
+  LLVMTypeRef idx_ptr_type  = LLVMPointerType(f.int32_type, 0 /* AddressSpace */);
+
+  // Struct fields (or whole structs) can't be vector lanes
+  int vectorize = opts.vector_width > 1 && is_vector_elem_type(f.val_type);
+
+  // New fn: gather (T*, Elem*, Int32*, Int64, Int64) Void, scatter (Elem*, T*, Int32*, Int64, Int64) Void
+  unsigned num_params       = 5;
+  LLVMTypeRef param_types[] = {
+    is_scatter ? elem_ptr_type : val_ptr_type,
+    is_scatter ? val_ptr_type  : elem_ptr_type,
+    idx_ptr_type,
+    f.int64_type,
+    f.int64_type
+  };
+  LLVMTypeRef return_type   = LLVMVoidTypeInContext(ctx);
+  LLVMTypeRef signature     = LLVMFunctionType(return_type, param_types, num_params, F);
+  LLVMValueRef fn           = LLVMAddFunction(mod, name, signature);
+
+  // Params
+  f.arg_base     = LLVMGetParam(fn, is_scatter ? 0 : 1);
+  f.arg_vals     = LLVMGetParam(fn, is_scatter ? 1 : 0);
+  f.arg_idx      = LLVMGetParam(fn, 2);
+  f.arg_len      = LLVMGetParam(fn, 3);
+  f.arg_base_len = LLVMGetParam(fn, 4);
+
+  // Consts
+  LLVMValueRef zero  = LLVMConstInt(f.int64_type, 0, F);
+  LLVMValueRef one   = LLVMConstInt(f.int64_type, 1, F);
+  LLVMValueRef lanes = LLVMConstInt(f.int64_type, opts.vector_width, F);
+
+  // Create blocks
+  LLVMBasicBlockRef entry       = LLVMAppendBasicBlockInContext(ctx, fn, "entry");
+  LLVMBasicBlockRef vec_cond    = vectorize ? LLVMAppendBasicBlockInContext(ctx, fn, "vec_cond") : NULL;
+  LLVMBasicBlockRef vec_body    = vectorize ? LLVMAppendBasicBlockInContext(ctx, fn, "vec_body") : NULL;
+  LLVMBasicBlockRef scalar_cond = LLVMAppendBasicBlockInContext(ctx, fn, "scalar_cond");
+  LLVMBasicBlockRef scalar_body = LLVMAppendBasicBlockInContext(ctx, fn, "scalar_body");
+  LLVMBasicBlockRef end         = LLVMAppendBasicBlockInContext(ctx, fn, "end");
+
+  // Create and position builder
+  LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx);
+  f.builder              = builder;
+
+  // Entry
+  //   represents: i = 0
+  LLVMPositionBuilderAtEnd(builder, entry);
+
+  LLVMValueRef i_addr = LLVMBuildAlloca(builder, f.int64_type, "i");
+
+  LLVMBuildStore(builder, zero, i_addr);
+  LLVMBuildBr(builder, vectorize ? vec_cond : scalar_cond);
+
+  // Vector loop
+  if (vectorize)
+  {
+    // Vector condition
+    //   represents: i + N <= length
+    {
+      LLVMPositionBuilderAtEnd(builder, vec_cond);
+
+      LLVMValueRef i       = LLVMBuildLoad2(builder, f.int64_type, i_addr, "");
+      LLVMValueRef i_lanes = LLVMBuildAdd(builder, i, lanes, "");
+      LLVMValueRef cond    = LLVMBuildICmp(builder, LLVMIntULE, i_lanes, f.arg_len, "");
+
+      LLVMBuildCondBr(builder, cond, vec_body, scalar_cond);
+    }
+
+    // Vector body
+    //   represents: access N elements; i += N
+    {
+      LLVMPositionBuilderAtEnd(builder, vec_body);
+
+      LLVMValueRef i = LLVMBuildLoad2(builder, f.int64_type, i_addr, "");
+
+      if (opts.prefetch_dist)
+      {
+        for (unsigned lane = 0; lane < opts.vector_width; lane++) build_prefetch(&f, i, lane);
+      }
+
+      build_vector_access(&f, i);
+
+      LLVMBuildStore(builder, LLVMBuildAdd(builder, i, lanes, ""), i_addr);
+      LLVMBuildBr(builder, vec_cond);
+    }
+  }
+
+  // Scalar condition
+  //   represents: i < length
+  {
+    LLVMPositionBuilderAtEnd(builder, scalar_cond);
+
+    LLVMValueRef i    = LLVMBuildLoad2(builder, f.int64_type, i_addr, "");
+    LLVMValueRef cond = LLVMBuildICmp(builder, LLVMIntULT, i, f.arg_len, "");
+
+    LLVMBuildCondBr(builder, cond, scalar_body, end);
+  }
+
+  // Scalar body
+  //   represents: access 1 element; i++
+  {
+    LLVMPositionBuilderAtEnd(builder, scalar_body);
+
+    LLVMValueRef i = LLVMBuildLoad2(builder, f.int64_type, i_addr, "");
+
+    if (opts.prefetch_dist) build_prefetch(&f, i, 0);
+
+    build_scalar_access(&f, fn, i);
+
+    LLVMBuildStore(builder, LLVMBuildAdd(builder, i, one, ""), i_addr);
+    LLVMBuildBr(builder, scalar_cond);
+  }
+
+  // End
+  LLVMPositionBuilderAtEnd(builder, end);
+
+  LLVMBuildRetVoid(builder);
+
+  // Cleanup
+  LLVMDisposeBuilder(builder);
+
+  return fn;
+}
+
+LLVMValueRef create_gather_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name,
+  LLVMTypeRef elem_type,
+  int field,
+  GatherOpts opts
+)
+{
+  return create_indexed_fn(ctx, mod, name, elem_type, field, opts, F);
+}
+
+LLVMValueRef create_scatter_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name,
+  LLVMTypeRef elem_type,
+  int field,
+  GatherOpts opts
+)
+{
+  return create_indexed_fn(ctx, mod, name, elem_type, field, opts, T);
+}
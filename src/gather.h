@@ -0,0 +1,31 @@
+#include <llvm-c/Core.h>
+
+typedef struct {
+  unsigned vector_width;  // lanes per llvm.masked.gather/scatter (8 x i32 = AVX2, 16 x i32 = AVX-512), 0 = scalar only
+  unsigned prefetch_dist; // prefetch base[idx[i + prefetch_dist]], 0 = off
+  int bounds_checked;     // idx >= base_len: gather yields 0, scatter skips
+} GatherOpts;
+
+// void name (T* out, Elem* base, uint32_t* idx, int64_t len, int64_t base_len)
+//   out[i] = base[idx[i]]        (field < 0)
+//   out[i] = base[idx[i]].field  (field >= 0, Elem is a struct)
+LLVMValueRef create_gather_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name,
+  LLVMTypeRef elem_type,
+  int field,
+  GatherOpts opts
+);
+
+// void name (Elem* base, T* src, uint32_t* idx, int64_t len, int64_t base_len)
+//   base[idx[i]]       = src[i]  (field < 0)
+//   base[idx[i]].field = src[i]  (field >= 0, Elem is a struct)
+LLVMValueRef create_scatter_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name,
+  LLVMTypeRef elem_type,
+  int field,
+  GatherOpts opts
+);
@@ -208,3 +208,39 @@ LLVMValueRef create_munge_fn (
 //    int *foo(struct ST *s) {
 //      return &s[1].Z.B[5][13];
 //    }
+//
+//    define i32* @foo(%struct.ST* %s) {
+//      entry:
+//        %arrayidx = getelementptr inbounds %struct.ST, %struct.ST* %s, i64 1, i32 2, i32 1, i64 5, i64 13
+//        ret i32* %arrayidx
+//    }
+//
+// Both structs are described once as LayoutTypes (see layout.c), GEP indices come from the field path
+
+static const LayoutType rt_b_row  = { LAYOUT_ARRAY, NULL, NULL, 0, &layout_i32, 20 };
+static const LayoutType rt_b      = { LAYOUT_ARRAY, NULL, NULL, 0, &rt_b_row,   10 };
+
+static const LayoutField rt_fields[] = {
+  { "A", &layout_i8 },
+  { "B", &rt_b },
+  { "C", &layout_i8 }
+};
+
+const LayoutType rt_layout = { LAYOUT_STRUCT, "RT", rt_fields, LEN(rt_fields) };
+
+static const LayoutField st_fields[] = {
+  { "X", &layout_i32 },
+  { "Y", &layout_f64 },
+  { "Z", &rt_layout }
+};
+
+const LayoutType st_layout = { LAYOUT_STRUCT, "ST", st_fields, LEN(st_fields) };
+
+LLVMValueRef create_foo_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name
+)
+{
+  return create_field_ptr_fn(ctx, mod, name, &st_layout, "[1].Z.B[5][13]");
+}
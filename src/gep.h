@@ -1,10 +1,27 @@
 #include <llvm-c/Core.h>
 
+#include "layout.h"
+
 typedef struct {
   int f1;
   int f2;
 } Munger;
 
+typedef struct {
+  char A;
+  int B[10][20];
+  char C;
+} RT;
+
+typedef struct {
+  int X;
+  double Y;
+  RT Z;
+} ST;
+
+extern const LayoutType rt_layout;
+extern const LayoutType st_layout;
+
 LLVMValueRef create_get_snd_int_fn (
   LLVMContextRef ctx,
   LLVMModuleRef mod,
@@ -18,3 +35,9 @@ LLVMValueRef create_munge_fn (
   const char* name,
   int num_bits
 );
+
+LLVMValueRef create_foo_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name
+);
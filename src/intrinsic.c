@@ -0,0 +1,20 @@
+#include "intrinsic.h"
+
+#include <string.h>
+
+LLVMValueRef get_intrinsic (
+  LLVMModuleRef mod,
+  const char* name,
+  LLVMTypeRef* types,
+  unsigned num_types,
+  LLVMTypeRef* signature
+)
+{
+  unsigned id = LLVMLookupIntrinsicID(name, strlen(name));
+
+  if (!LLVMIntrinsicIsOverloaded(id)) num_types = 0;
+
+  *signature = LLVMIntrinsicGetType(LLVMGetModuleContext(mod), id, types, num_types);
+
+  return LLVMGetIntrinsicDeclaration(mod, id, types, num_types);
+}
@@ -0,0 +1,17 @@
+#ifndef INTRINSIC_H
+#define INTRINSIC_H
+
+#include <llvm-c/Core.h>
+
+// Declare (or reuse) intrinsic `name` in `mod`, e.g. llvm.sadd.sat overloaded on <16 x i8> is llvm.sadd.sat.v16i8
+// - types: overload types in the intrinsic's order, ignored (may be NULL) for non overloaded ones like llvm.trap
+// - signature: set to the fn type, for LLVMBuildCall2
+LLVMValueRef get_intrinsic (
+  LLVMModuleRef mod,
+  const char* name,
+  LLVMTypeRef* types,
+  unsigned num_types,
+  LLVMTypeRef* signature
+);
+
+#endif
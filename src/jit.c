@@ -0,0 +1,283 @@
+// Adaptive opt level selection for MCJIT
+//
+// - cost of a module is estimated from its IR (instruction count, loops, recursion)
+// - caller gives a compile latency budget, plan picks the highest opt level that is
+//   both worth it (hot looking code) and predicted to fit the budget
+// - every compile is timed and the per opt level model is refit (decayed least squares), so
+//   predictions converge to what this machine/LLVM build actually does
+
+#include "jit.h"
+#include "opt.h"
+#include "util.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#define JIT_EMA_WEIGHT     0.25  // Weight of newest sample when calibrating
+#define JIT_PRIOR_WEIGHT   0.125 // Weight of each of the 2 prior points, keeps the fit sane w/ few or identical samples
+#define JIT_PRIOR_INSTS    500.0 // Prior points are at 0 and this many insts
+#define JIT_PROBE_INTERVAL 100   // Compiles between probes of an unsampled level, bounds how often a probe can blow the budget
+
+// Priors, measured w/ MCJIT on x86-64 for small modules
+// - building the pass pipeline dominates fixed cost once opt level > 0
+static const double prior_fixed_ms[]    = { 1.5,   8.0,  10.0,  10.0  };
+static const double prior_ms_per_inst[] = { 0.005, 0.05,  0.06,  0.07  };
+
+void jit_tuner_init (
+  JitTuner* tuner
+)
+{
+  for (int i = 0; i < 4; i++)
+  {
+    tuner->fixed_ms[i]    = prior_fixed_ms[i];
+    tuner->ms_per_inst[i] = prior_ms_per_inst[i];
+    tuner->num_samples[i] = 0;
+    tuner->sum_w[i]       = 0;
+    tuner->sum_x[i]       = 0;
+    tuner->sum_y[i]       = 0;
+    tuner->sum_xx[i]      = 0;
+    tuner->sum_xy[i]      = 0;
+  }
+
+  tuner->sum_prior_ratio   = 0;
+  tuner->sum_prior_ratio_w = 0;
+}
+
+// Back edges (branch to a block at or before the current one) and direct self calls
+static unsigned count_loops (
+  LLVMValueRef fn
+)
+{
+  unsigned num_loops        = 0;
+  unsigned num_blocks       = LLVMCountBasicBlocks(fn);
+  LLVMBasicBlockRef* blocks = malloc(sizeof(LLVMBasicBlockRef) * num_blocks);
+
+  LLVMGetBasicBlocks(fn, blocks);
+
+  for (unsigned b = 0; b < num_blocks; b++)
+  {
+    // Branches
+    LLVMValueRef term = LLVMGetBasicBlockTerminator(blocks[b]);
+    unsigned num_succ = term ? LLVMGetNumSuccessors(term) : 0;
+
+    for (unsigned s = 0; s < num_succ; s++)
+    {
+      LLVMBasicBlockRef succ = LLVMGetSuccessor(term, s);
+
+      for (unsigned prev = 0; prev <= b; prev++)
+      {
+        if (blocks[prev] == succ) num_loops++;
+      }
+    }
+
+    // Recursion
+    for (LLVMValueRef inst = LLVMGetFirstInstruction(blocks[b]); inst; inst = LLVMGetNextInstruction(inst))
+    {
+      if (LLVMGetInstructionOpcode(inst) == LLVMCall && LLVMGetCalledValue(inst) == fn) num_loops++;
+    }
+  }
+
+  free(blocks);
+
+  return num_loops;
+}
+
+JitCost jit_estimate_cost (
+  LLVMModuleRef mod
+)
+{
+  JitCost cost = { 0, 0, 0, 0 };
+
+  for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn))
+  {
+    if (LLVMIsDeclaration(fn)) continue;
+
+    cost.num_fns++;
+    cost.num_loops += count_loops(fn);
+
+    for (LLVMBasicBlockRef bb = LLVMGetFirstBasicBlock(fn); bb; bb = LLVMGetNextBasicBlock(bb))
+    {
+      cost.num_blocks++;
+
+      for (LLVMValueRef inst = LLVMGetFirstInstruction(bb); inst; inst = LLVMGetNextInstruction(inst))
+      {
+        cost.num_insts++;
+      }
+    }
+  }
+
+  return cost;
+}
+
+static double prior_estimate_ms (
+  double num_insts,
+  unsigned opt_level
+)
+{
+  return prior_fixed_ms[opt_level] + num_insts * prior_ms_per_inst[opt_level];
+}
+
+static double estimate_ms (
+  const JitTuner* tuner,
+  JitCost cost,
+  unsigned opt_level
+)
+{
+  // Never measured: prior, corrected by how far off priors were elsewhere (same machine, same LLVM build)
+  if (tuner->num_samples[opt_level] == 0 && tuner->sum_prior_ratio_w > 0)
+  {
+    return prior_estimate_ms(cost.num_insts, opt_level) * tuner->sum_prior_ratio / tuner->sum_prior_ratio_w;
+  }
+
+  return tuner->fixed_ms[opt_level] + cost.num_insts * tuner->ms_per_inst[opt_level];
+}
+
+JitPlan jit_plan (
+  const JitTuner* tuner,
+  JitCost cost,
+  double budget_ms
+)
+{
+  // Most we would want: -O3 only pays off when code runs repeatedly
+  unsigned max_level = cost.num_loops ? 3 : 1;
+  unsigned opt_level = max_level;
+
+  // Back off until predicted compile time fits, -O0 is the floor even if it doesn't
+  while (opt_level > 0 && budget_ms > 0 && estimate_ms(tuner, cost, opt_level) > budget_ms)
+  {
+    opt_level--;
+  }
+
+  // Probe the next level up now and then, it can't be corrected until it's measured once
+  unsigned num_compiles = tuner->num_samples[0] + tuner->num_samples[1] + tuner->num_samples[2] + tuner->num_samples[3];
+
+  if (opt_level < max_level && tuner->num_samples[opt_level + 1] == 0 && num_compiles % JIT_PROBE_INTERVAL == JIT_PROBE_INTERVAL - 1)
+  {
+    opt_level++;
+  }
+
+  JitPlan plan = {
+    opt_level,
+    opt_level, // LLVMCodeGenLevelNone..Aggressive line up w/ -O0..-O3
+    estimate_ms(tuner, cost, opt_level),
+    0.0
+  };
+
+  return plan;
+}
+
+static double now_ms ()
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return ts.tv_sec * 1e3 + ts.tv_nsec / 1e6;
+}
+
+static void calibrate (
+  JitTuner* tuner,
+  JitCost cost,
+  JitPlan plan
+)
+{
+  unsigned level = plan.opt_level;
+  double x       = cost.num_insts;
+  double y       = plan.actual_ms;
+
+  // Decay old samples, add the new one
+  tuner->sum_w[level]  = (1 - JIT_EMA_WEIGHT) * tuner->sum_w[level]  + JIT_EMA_WEIGHT;
+  tuner->sum_x[level]  = (1 - JIT_EMA_WEIGHT) * tuner->sum_x[level]  + JIT_EMA_WEIGHT * x;
+  tuner->sum_y[level]  = (1 - JIT_EMA_WEIGHT) * tuner->sum_y[level]  + JIT_EMA_WEIGHT * y;
+  tuner->sum_xx[level] = (1 - JIT_EMA_WEIGHT) * tuner->sum_xx[level] + JIT_EMA_WEIGHT * x * x;
+  tuner->sum_xy[level] = (1 - JIT_EMA_WEIGHT) * tuner->sum_xy[level] + JIT_EMA_WEIGHT * x * y;
+  tuner->num_samples[level]++;
+
+  // How far off the priors are, for levels not sampled yet
+  double prior_y = prior_estimate_ms(x, level);
+
+  if (prior_y > 0)
+  {
+    tuner->sum_prior_ratio   = (1 - JIT_EMA_WEIGHT) * tuner->sum_prior_ratio   + JIT_EMA_WEIGHT * y / prior_y;
+    tuner->sum_prior_ratio_w = (1 - JIT_EMA_WEIGHT) * tuner->sum_prior_ratio_w + JIT_EMA_WEIGHT;
+  }
+
+  // Prior line as 2 weighted points, at 0 and JIT_PRIOR_INSTS insts
+  double prior_y0 = prior_fixed_ms[level];
+  double prior_y1 = prior_fixed_ms[level] + JIT_PRIOR_INSTS * prior_ms_per_inst[level];
+
+  double w   = tuner->sum_w[level]  + 2 * JIT_PRIOR_WEIGHT;
+  double sx  = tuner->sum_x[level]  + JIT_PRIOR_WEIGHT * JIT_PRIOR_INSTS;
+  double sy  = tuner->sum_y[level]  + JIT_PRIOR_WEIGHT * (prior_y0 + prior_y1);
+  double sxx = tuner->sum_xx[level] + JIT_PRIOR_WEIGHT * JIT_PRIOR_INSTS * JIT_PRIOR_INSTS;
+  double sxy = tuner->sum_xy[level] + JIT_PRIOR_WEIGHT * JIT_PRIOR_INSTS * prior_y1;
+
+  // Weighted least squares, the prior points at 2 distinct x keep the denominator > 0
+  double slope     = (w * sxy - sx * sy) / (w * sxx - sx * sx);
+  double intercept = (sy - slope * sx) / w;
+
+  // Compile time can't shrink w/ size, nor be negative
+  if (slope < 0)
+  {
+    slope     = 0;
+    intercept = sy / w;
+  }
+
+  if (intercept < 0)
+  {
+    intercept = 0;
+    slope     = sxy / sxx;
+  }
+
+  tuner->fixed_ms[level]    = intercept;
+  tuner->ms_per_inst[level] = slope;
+}
+
+int jit_compile (
+  JitTuner* tuner,
+  LLVMModuleRef mod,
+  double budget_ms,
+  LLVMMCJITMemoryManagerRef mm,
+  LLVMExecutionEngineRef* engine,
+  JitPlan* plan
+)
+{
+  JitCost cost = jit_estimate_cost(mod);
+  *plan        = jit_plan(tuner, cost, budget_ms);
+
+  // Compile
+  double start = now_ms();
+
+  target_host_cpu(mod);
+  optimize_module(mod, plan->opt_level);
+
+  // Find a fn to force codegen w/ (MCJIT compiles lazily, whole module at once)
+  const char* first_fn = NULL;
+
+  for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn && !first_fn; fn = LLVMGetNextFunction(fn))
+  {
+    if (!LLVMIsDeclaration(fn)) first_fn = LLVMGetValueName(fn);
+  }
+
+  struct LLVMMCJITCompilerOptions options;
+  LLVMInitializeMCJITCompilerOptions(&options, sizeof(options));
+  options.OptLevel = plan->codegen_level;
+  options.MCJMM    = mm;
+
+  char* err = NULL;
+
+  if (LLVMCreateMCJITCompilerForModule(engine, mod, &options, sizeof(options), &err) != 0)
+  {
+    fprintf(stderr, "Failed to create execution engine: %s\n", err ? err : "(unknown)");
+    LLVMDisposeMessage(err);
+    return 1;
+  }
+
+  if (first_fn) LLVMGetFunctionAddress(*engine, first_fn);
+
+  plan->actual_ms = now_ms() - start;
+
+  // Feed back
+  calibrate(tuner, cost, *plan);
+
+  return 0;
+}
@@ -0,0 +1,75 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <llvm-c/Core.h>
+#include <llvm-c/ExecutionEngine.h>
+
+// Static cost of IR, used to predict compile time and how hot the code is likely to be
+typedef struct {
+  unsigned num_fns;
+  unsigned num_blocks;
+  unsigned num_insts;
+  unsigned num_loops; // back edges + self recursive calls
+} JitCost;
+
+// Opt levels picked for a compile and how long it took
+typedef struct {
+  unsigned opt_level;      // IR pipeline, 0-3
+  unsigned codegen_level;  // LLVMCodeGenOptLevel, 0-3
+  double estimated_ms;
+  double actual_ms;
+} JitPlan;
+
+// Compile time model, calibrated by every jit_compile
+// - per opt level: estimated_ms = fixed_ms + num_insts * ms_per_inst
+// - both terms are a least squares fit of (num_insts, actual_ms) samples, older samples decay and priors anchor the fit
+// - levels w/o samples use their prior scaled by how far off the priors were on sampled levels
+typedef struct {
+  double fixed_ms[4];
+  double ms_per_inst[4];
+  unsigned num_samples[4];
+
+  // Decayed sample sums per opt level
+  double sum_w[4];
+  double sum_x[4];
+  double sum_y[4];
+  double sum_xx[4];
+  double sum_xy[4];
+
+  // Decayed mean of actual_ms / prior estimate, over all levels
+  double sum_prior_ratio;
+  double sum_prior_ratio_w;
+} JitTuner;
+
+void jit_tuner_init (
+  JitTuner* tuner
+);
+
+JitCost jit_estimate_cost (
+  LLVMModuleRef mod
+);
+
+// Highest useful opt level whose estimated compile time fits `budget_ms` (<= 0 is unbounded)
+// - straight line code stops at -O1, only code w/ loops or recursion is worth -O3
+// - every JIT_PROBE_INTERVAL (jit.c) compiles, a never sampled level just above the pick is tried regardless of budget,
+//   otherwise a level whose estimate is too high would never be measured and corrected
+JitPlan jit_plan (
+  const JitTuner* tuner,
+  JitCost cost,
+  double budget_ms
+);
+
+// Optimize `mod` per jit_plan, create an MCJIT engine for it (takes ownership) and force codegen
+// - mm: custom memory manager (engine takes ownership), NULL for MCJIT's default
+// - measured compile time is fed back into `tuner`
+// - returns 0 on success
+int jit_compile (
+  JitTuner* tuner,
+  LLVMModuleRef mod,
+  double budget_ms,
+  LLVMMCJITMemoryManagerRef mm,
+  LLVMExecutionEngineRef* engine,
+  JitPlan* plan
+);
+
+#endif
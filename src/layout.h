@@ -0,0 +1,81 @@
+#ifndef LAYOUT_H
+#define LAYOUT_H
+
+#include <llvm-c/Core.h>
+
+// Typed description of nested structs and fixed arrays
+// - described once, LLVM types, field path GEPs and layout reports are derived from it
+// - fields are looked up by name so accessors keep working after layout_reorder
+typedef enum {
+  LAYOUT_I8,
+  LAYOUT_I16,
+  LAYOUT_I32,
+  LAYOUT_I64,
+  LAYOUT_F32,
+  LAYOUT_F64,
+  LAYOUT_STRUCT,
+  LAYOUT_ARRAY
+} LayoutKind;
+
+typedef struct LayoutType LayoutType;
+
+typedef struct {
+  const char* name;
+  const LayoutType* type;
+} LayoutField;
+
+struct LayoutType {
+  LayoutKind kind;
+  const char* name;          // LAYOUT_STRUCT: LLVM type is %struct.<name>
+  const LayoutField* fields; // LAYOUT_STRUCT
+  unsigned num_fields;
+  const LayoutType* elem;    // LAYOUT_ARRAY
+  unsigned count;
+};
+
+extern const LayoutType layout_i8;
+extern const LayoutType layout_i16;
+extern const LayoutType layout_i32;
+extern const LayoutType layout_i64;
+extern const LayoutType layout_f32;
+extern const LayoutType layout_f64;
+
+// Named structs are created once per ctx and reused
+// - reuse requires the existing %struct.<name> body to match `type` field for field, NULL (and an error) otherwise
+LLVMTypeRef layout_llvm_type (
+  LLVMModuleRef mod,
+  const LayoutType* type
+);
+
+// New fn: name (Root*, Int64...) Leaf*, returning the address `path` names
+// - path: optional leading [n] on the pointer, then .field and [n] segments, e.g. "[1].Z.B[5][13]"
+// - [] takes the index from the next Int64 param instead, e.g. "[].Z.B[][]" is name (ST*, Int64, Int64, Int64) Int32*
+// - returns NULL (and no fn) on a malformed path or unknown field
+LLVMValueRef create_field_ptr_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name,
+  const LayoutType* root,
+  const char* path
+);
+
+// Print offset, size and padding of every field (nested structs expanded) per the module's data layout
+// - non struct roots (scalars, arrays) only print their LLVM type, size and padding
+void layout_print (
+  LLVMModuleRef mod,
+  const LayoutType* type
+);
+
+// Copy of `type` w/ fields of every struct (nested ones too) sorted by decreasing alignment, which minimizes padding
+// - structs are renamed <name>.reordered, free w/ layout_free
+// - NULL if a reordered struct clashes w/ an existing one, see layout_llvm_type
+LayoutType* layout_reorder (
+  LLVMModuleRef mod,
+  const LayoutType* type
+);
+
+void layout_free (
+  LayoutType* type
+);
+
+#endif
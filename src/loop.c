@@ -104,7 +104,7 @@ LLVMValueRef create_loop_fn (
     // Build condition (i < length)
     LLVMValueRef cond = LLVMBuildICmp(
       builder,
-      LLVMIntSLE,
+      LLVMIntSLT,
       i,
       arg_len,
       ""
@@ -9,10 +9,17 @@
 #include "fib.h"
 #include "loop.h"
 #include "gep.h"
+#include "gather.h"
+#include "diff.h"
+#include "jit.h"
+#include "engine.h"
+#include "aot.h"
+#include "util.h"
 
 #include <inttypes.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 typedef struct {
   LLVMContextRef ctx;
@@ -34,7 +41,9 @@ static LLVMValueRef add_fn_signature (
   return fn;
 }
 
-static int init_env ()
+static int init_env (
+  LLVMTargetMachineRef* tm_ref
+)
 {
   // Initialize
   LLVMLinkInMCJIT();
@@ -54,7 +63,7 @@ static int init_env ()
   }
 
   // 
-  LLVMTargetMachineRef tm_ref = LLVMCreateTargetMachine(
+  *tm_ref = LLVMCreateTargetMachine(
     target_ref,              // 
     triple,                  // 
     "",                      // const char* cpu
@@ -68,10 +77,122 @@ static int init_env ()
   return 0;
 }
 
+//--- Engine manager units, rebuilt from scratch whenever an evicted unit is used again
+
+static void gen_sum_unit (LLVMContextRef ctx, LLVMModuleRef mod, void* arg)
+{
+  create_int_sum_fn(ctx, mod, "sum", 32, INT_WRAP);
+}
+
+static void gen_fib_unit (LLVMContextRef ctx, LLVMModuleRef mod, void* arg)
+{
+  create_fib_fn(ctx, mod, "fib", 32, INT_WRAP);
+}
+
+static void gen_loop_unit (LLVMContextRef ctx, LLVMModuleRef mod, void* arg)
+{
+  create_loop_fn(ctx, mod, "loop");
+}
+
+static void gen_gather_unit (LLVMContextRef ctx, LLVMModuleRef mod, void* arg)
+{
+  GatherOpts opts = { 8 /* lanes */, 16 /* prefetch dist */, T /* bounds checked */ };
+
+  create_gather_fn(ctx, mod, "gather", LLVMInt32TypeInContext(ctx), -1 /* whole elem */, opts);
+}
+
+// Cycle through units under a memory cap, every call is checked against C
+// - returns # of mismatches
+static unsigned run_engines (
+  unsigned long long cap_bytes,
+  unsigned rounds,
+  double budget_ms
+)
+{
+  EngineManager mgr;
+  engine_manager_init(&mgr, cap_bytes, budget_ms);
+
+  int sum_unit    = engine_manager_add(&mgr, "sum", gen_sum_unit, NULL);
+  int fib_unit    = engine_manager_add(&mgr, "fib", gen_fib_unit, NULL);
+  int loop_unit   = engine_manager_add(&mgr, "loop", gen_loop_unit, NULL);
+  int gather_unit = engine_manager_add(&mgr, "gather", gen_gather_unit, NULL);
+
+  typedef void (*GatherFn) (void*, void*, uint32_t*, long int, long int);
+
+  unsigned failures = 0;
+
+  for (unsigned r = 0; r < rounds; r++)
+  {
+    int a = (int) r * 7 - 50;
+    int b = (int) r * 3 + 1;
+
+    // Hot: sum/fib every round, cold: loop/gather every few
+    // - sum is still called after getting fib, pinned so compiling fib can't evict it
+    int (*sum) (int, int) = (int (*) (int, int)) engine_manager_get(&mgr, sum_unit, "sum");
+    engine_manager_pin(&mgr, sum_unit);
+
+    int (*fib) (int) = (int (*) (int)) engine_manager_get(&mgr, fib_unit, "fib");
+
+    if (!sum || sum(a, b) != a + b) failures++;
+    if (!fib || fib(10) != 55) failures++;
+
+    engine_manager_unpin(&mgr, sum_unit);
+
+    if (r % 3 == 0)
+    {
+      double x[5] = { 0, 1, 2, 3, r };
+      double y[5] = { 0, 10, 20, 30, 40 };
+      double result[5];
+
+      void (*loop) (double*, double*, double*, long int) = (void (*) (double*, double*, double*, long int)) engine_manager_get(&mgr, loop_unit, "loop");
+      if (!loop) failures++;
+      else
+      {
+        loop(result, x, y, LEN(x));
+
+        for (int i = 0; i < LEN(x); i++)
+        {
+          if (result[i] != x[i] * y[i]) failures++;
+        }
+      }
+    }
+
+    if (r % 5 == 0)
+    {
+      int base[5]      = { 100, 101, 102, 103, (int) r };
+      uint32_t idx[10] = { 4, 7, 3, 3, 1, 9, 0, 4, 2, 1 };
+      int gathered[10];
+
+      GatherFn gather = (GatherFn) engine_manager_get(&mgr, gather_unit, "gather");
+      if (!gather) failures++;
+      else
+      {
+        gather(gathered, base, idx, LEN(idx), LEN(base));
+
+        for (int i = 0; i < LEN(idx); i++)
+        {
+          if (gathered[i] != (idx[i] < LEN(base) ? base[idx[i]] : 0)) failures++;
+        }
+      }
+    }
+  }
+
+  printf("\n--- engines ---\n");
+  engine_manager_print(&mgr);
+  printf("\t%u rounds, %u failures\n", rounds, failures);
+  printf("----------------------\n");
+
+  engine_manager_dispose(&mgr);
+
+  return failures;
+}
+
 int main (int argc, char const* argv[])
 {
   // Initialize
-  int ret = init_env();
+  LLVMTargetMachineRef tm_ref = NULL;
+
+  int ret = init_env(&tm_ref);
   if (ret) return ret;
 
   //--- Build LLVM IR
@@ -83,13 +204,46 @@ int main (int argc, char const* argv[])
   //LLVMModuleRef mod = LLVMModuleCreateWithName("my_module"); // Implicitly global ctx
   LLVMModuleRef mod = LLVMModuleCreateWithNameInContext("my_module", ctx);
 
+  // Target data layout, struct offsets/sizes depend on it (see layout.c)
+  char* triple         = LLVMGetTargetMachineTriple(tm_ref);
+  LLVMTargetDataRef td = LLVMCreateTargetDataLayout(tm_ref);
+
+  LLVMSetTarget(mod, triple);
+  LLVMSetModuleDataLayout(mod, td);
+  LLVMDisposeMessage(triple);
+
   // Add functions
-  create_int_sum_fn(ctx, mod, "sum", 32);
-  create_fib_fn(ctx, mod, "fib", 32);
+  create_int_sum_fn(ctx, mod, "sum", 32, INT_WRAP);
+  create_int_sum_fn(ctx, mod, "sum_nsw", 32, INT_NSW);
+  create_int_sum_fn(ctx, mod, "sum_nuw", 32, INT_NUW);
+  create_int_sum_fn(ctx, mod, "sum_sat8", 8, INT_SAT_SIGNED);
+  create_int_sum_vec_fn(ctx, mod, "sum_vec", 8, INT_SAT_SIGNED, 128 /* vector bits */);
+  create_int_sum_vec_fn(ctx, mod, "sum_usat16_vec", 16, INT_SAT_UNSIGNED, 128 /* vector bits */);
+  create_int_sum_fn(ctx, mod, "sum_i17", 17, INT_WRAP);
+  create_int_sum_vec_fn(ctx, mod, "sum_i17_vec", 17, INT_WRAP, 256 /* vector bits */);
+  create_int_sum_fn(ctx, mod, "sum_trap", 32, INT_TRAP_SIGNED);
+  create_int_sum_fn(ctx, mod, "sum_trap_u", 32, INT_TRAP_UNSIGNED);
+  create_int_sum_vec_fn(ctx, mod, "sum_trap_vec", 32, INT_TRAP_SIGNED, 128 /* vector bits */);
+  create_fib_fn(ctx, mod, "fib", 32, INT_WRAP);
+  create_fib_fn(ctx, mod, "fib_sat8", 8, INT_SAT_SIGNED);
   create_loop_fn(ctx, mod, "loop");
   create_get_snd_int_fn(ctx, mod, "get_snd_int", 32);
   create_munge_fn(ctx, mod, "munge", sizeof(int) * 8 /* # bits */);
 
+  LLVMTypeRef int_type              = LLVMInt32TypeInContext(ctx);
+  LLVMTypeRef munger_elem_types[]   = { int_type, int_type };
+  LLVMTypeRef munger_type           = LLVMStructTypeInContext(ctx, munger_elem_types, 2, F /* Packed */);
+  GatherOpts gather_opts            = { 8 /* lanes */, 16 /* prefetch dist */, F /* bounds checked */ };
+  GatherOpts gather_munger_f2_opts  = { 8 /* lanes */, 0  /* prefetch dist */, T /* bounds checked */ };
+  GatherOpts scatter_opts           = { 16 /* lanes */, 0 /* prefetch dist */, T /* bounds checked */ };
+
+  create_gather_fn(ctx, mod, "gather", int_type, -1 /* whole elem */, gather_opts);
+  create_gather_fn(ctx, mod, "gather_munger_f2", munger_type, 1 /* f2 */, gather_munger_f2_opts);
+  create_scatter_fn(ctx, mod, "scatter", int_type, -1 /* whole elem */, scatter_opts);
+
+  create_foo_fn(ctx, mod, "foo");
+  create_field_ptr_fn(ctx, mod, "st_z_b", &st_layout, "[].Z.B[][]");
+
   //--- Analysis and execution
 
   // Verify the module
@@ -98,30 +252,97 @@ int main (int argc, char const* argv[])
   LLVMVerifyModule(mod, LLVMAbortProcessAction, &err);
   LLVMDisposeMessage(err);
 
-  // Build executor
-  err                           = NULL;
-  LLVMExecutionEngineRef engine = NULL;
+  // Differential test mode: `./main diff [iterations] [seed]`
+  if (argc > 1 && strcmp(argv[1], "diff") == 0)
+  {
+    unsigned iterations     = argc > 2 ? (unsigned) strtoul(argv[2], NULL, 10) : 1000;
+    unsigned long long seed = argc > 3 ? strtoull(argv[3], NULL, 10) : 1;
+    unsigned failures       = run_diff_tests(mod, iterations, seed);
+
+    LLVMDisposeModule(mod);
+    LLVMContextDispose(ctx);
+    LLVMDisposeTargetData(td);
+    LLVMDisposeTargetMachine(tm_ref);
 
-  if (LLVMCreateExecutionEngineForModule(&engine, mod, &err) != 0)
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  // Engine manager mode: `./main engines [cap KB] [rounds] [compile budget ms]`
+  if (argc > 1 && strcmp(argv[1], "engines") == 0)
   {
-    fprintf(stderr, "Failed to create execution engine\n");
-    abort();
+    unsigned long long cap_bytes = (argc > 2 ? strtoull(argv[2], NULL, 10) : 16) * 1024;
+    unsigned rounds              = argc > 3 ? (unsigned) strtoul(argv[3], NULL, 10) : 30;
+    double engines_budget_ms     = argc > 4 ? strtod(argv[4], NULL) : 0.0;
+    unsigned failures            = run_engines(cap_bytes, rounds, engines_budget_ms);
+
+    LLVMDisposeModule(mod);
+    LLVMContextDispose(ctx);
+    LLVMDisposeTargetData(td);
+    LLVMDisposeTargetMachine(tm_ref);
+
+    return failures ? EXIT_FAILURE : EXIT_SUCCESS;
   }
 
-  if (err)
+  // AOT mode: `./main aot <out.o|out.so> [opt level] [native]`
+  // - same fns and IR pipeline as the JIT, plus a header w/ their prototypes next to the output (out.h)
+  // - native tunes for this machine's CPU, otherwise code runs on any CPU of the target triple
+  if (argc > 2 && strcmp(argv[1], "aot") == 0)
+  {
+    const char* path  = argv[2];
+    AotOpts aot_opts  = { aot_kind_from_path(path), argc > 3 ? (unsigned) strtoul(argv[3], NULL, 10) : 3, argc > 4 && strcmp(argv[4], "native") == 0 };
+    const char* ext   = strrchr(path, '.');
+    size_t stem_len   = ext && !strchr(ext, '/') ? (size_t) (ext - path) : strlen(path);
+    char* header_path = malloc(stem_len + 3);
+
+    memcpy(header_path, path, stem_len);
+    strcpy(header_path + stem_len, ".h");
+
+    ret = aot_emit(mod, path, aot_opts) || aot_write_header(mod, header_path);
+
+    if (!ret) printf("Wrote %s (-O%u, %s cpu) and %s\n", path, aot_opts.opt_level, aot_opts.host_cpu ? "host" : "generic", header_path);
+
+    free(header_path);
+    LLVMDisposeModule(mod);
+    LLVMContextDispose(ctx);
+    LLVMDisposeTargetData(td);
+    LLVMDisposeTargetMachine(tm_ref);
+
+    return ret ? EXIT_FAILURE : EXIT_SUCCESS;
+  }
+
+  // Build executor
+  // - `./main [compile budget ms]`, opt levels are picked to fit the budget (none given: unbounded)
+  // - compile a clone so `mod` is still the unoptimized IR when dumped below
+  double budget_ms              = argc > 1 ? strtod(argv[1], NULL) : 0.0;
+  LLVMExecutionEngineRef engine = NULL;
+  JitTuner tuner;
+  JitPlan plan;
+
+  jit_tuner_init(&tuner);
+
+  if (jit_compile(&tuner, LLVMCloneModule(mod), budget_ms, NULL, &engine, &plan) != 0)
   {
-    fprintf(stderr, "Error: %s\n", err);
-    LLVMDisposeMessage(err);
     exit(EXIT_FAILURE);
   }
 
   // Get functions
   int  (*sum)         (int, int)                            = (int  (*) (int, int))                            LLVMGetFunctionAddress(engine, "sum");
+  int8_t (*sum_sat8)  (int8_t, int8_t)                      = (int8_t (*) (int8_t, int8_t))                    LLVMGetFunctionAddress(engine, "sum_sat8");
+  void (*sum_vec)     (int8_t*, int8_t*, int8_t*, long int) = (void (*) (int8_t*, int8_t*, int8_t*, long int)) LLVMGetFunctionAddress(engine, "sum_vec");
   int  (*fib)         (int)                                 = (int  (*) (int))                                 LLVMGetFunctionAddress(engine, "fib");
   void (*loop)        (double*, double*, double*, long int) = (void (*) (double*, double*, double*, long int)) LLVMGetFunctionAddress(engine, "loop");
   int  (*get_snd_int) (int*)                                = (int  (*) (int*))                                LLVMGetFunctionAddress(engine, "get_snd_int");
   void (*munge)       (Munger*)                             = (void (*) (Munger*))                             LLVMGetFunctionAddress(engine, "munge");
 
+  typedef void (*GatherFn) (void*, void*, uint32_t*, long int, long int);
+
+  GatherFn gather           = (GatherFn) LLVMGetFunctionAddress(engine, "gather");
+  GatherFn gather_munger_f2 = (GatherFn) LLVMGetFunctionAddress(engine, "gather_munger_f2");
+  GatherFn scatter          = (GatherFn) LLVMGetFunctionAddress(engine, "scatter");
+
+  int* (*foo)    (ST*)                               = (int* (*) (ST*))                               LLVMGetFunctionAddress(engine, "foo");
+  int* (*st_z_b) (ST*, long int, long int, long int) = (int* (*) (ST*, long int, long int, long int)) LLVMGetFunctionAddress(engine, "st_z_b");
+
   // Run loop test
   size_t num_elems = 5;
   double* x        = malloc(sizeof(double) * num_elems);
@@ -136,6 +357,19 @@ int main (int argc, char const* argv[])
 
   loop(result, x, y, num_elems);
 
+  // Run sum_vec test
+  int8_t vec_x[20];
+  int8_t vec_y[20];
+  int8_t vec_result[20];
+
+  for (int i = 0; i < LEN(vec_x); i++)
+  {
+    vec_x[i] = i * 6;
+    vec_y[i] = i * 5;
+  }
+
+  sum_vec(vec_result, vec_x, vec_y, LEN(vec_x));
+
   // Run get_snd_int test
   int my_ints[3] = { 10, 20, 30 };
 
@@ -146,7 +380,29 @@ int main (int argc, char const* argv[])
     { 3, 4 }
   };
 
+  // Run gather/scatter tests
+  // - idx 7 and 9 are past the end of the 5 elem arrays, only used by the bounds checked fns
+  int base_ints[5]         = { 100, 101, 102, 103, 104 };
+  Munger base_mungers[5]   = { { 0, 10 }, { 1, 11 }, { 2, 12 }, { 3, 13 }, { 4, 14 } };
+  uint32_t idx[10]         = { 4, 0, 3, 3, 1, 2, 0, 4, 2, 1 };
+  uint32_t checked_idx[10] = { 4, 7, 3, 3, 1, 9, 0, 4, 2, 1 };
+  int gathered[10];
+  int gathered_f2[10];
+  int scattered[5]         = { 0, 0, 0, 0, 0 };
+  int src[10]              = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9 };
+
+  gather(gathered, base_ints, idx, LEN(idx), LEN(base_ints));
+  gather_munger_f2(gathered_f2, base_mungers, checked_idx, LEN(checked_idx), LEN(base_mungers));
+  scatter(scattered, src, checked_idx, LEN(checked_idx), LEN(scattered));
+
   // Test
+  printf("\n--- jit ---\n");
+  if (budget_ms > 0) printf("\tbudget:       %.2f ms\n", budget_ms);
+  else               printf("\tbudget:       unbounded\n");
+  printf("\topt level:    -O%u (codegen %u)\n", plan.opt_level, plan.codegen_level);
+  printf("\tcompile time: %.2f ms (estimated %.2f ms)\n", plan.actual_ms, plan.estimated_ms);
+  printf("----------------------\n");
+
   printf("\n--- testing sum fn ---\n");
   printf("\tsum 0 0: %d\n", sum(0, 0));
   printf("\tsum 0 1: %d\n", sum(0, 1));
@@ -154,6 +410,18 @@ int main (int argc, char const* argv[])
   printf("\tsum 1 1: %d\n", sum(1, 1));
   printf("----------------------\n");
 
+  printf("\n--- testing sum_sat8 fn ---\n");
+  printf("\tsum_sat8 100 27:    %d\n", sum_sat8(100, 27));
+  printf("\tsum_sat8 100 28:    %d\n", sum_sat8(100, 28));
+  printf("\tsum_sat8 -100 -100: %d\n", sum_sat8(-100, -100));
+  printf("----------------------\n");
+
+  printf("\n--- testing sum_vec fn (i8, saturating, 16 lanes + tail) ---\n");
+  printf("\tresult[]: [");
+  for (int i = 0; i < LEN(vec_result); i++) printf(i ? ", %d" : "%d", vec_result[i]);
+  printf("]\n");
+  printf("----------------------\n");
+
   printf("\n--- testing fib fn ---\n");
   printf("\tfib 0:   %d\n", fib(0));
   printf("\tfib 1:   %d\n", fib(1));
@@ -178,6 +446,39 @@ int main (int argc, char const* argv[])
   printf("\tafter munge:  [ { f1:%d, f2:%d }, { f1:%d, f2:%d }, { f1:%d, f2:%d } ]\n", mungers[0].f1, mungers[0].f2, mungers[1].f1, mungers[1].f2, mungers[2].f1, mungers[2].f2);
   printf("----------------------\n");
 
+  printf("\n--- testing gather/scatter fns ---\n");
+  printf("\tidx:                            [");
+  for (int i = 0; i < LEN(idx); i++) printf(i ? ", %u" : "%u", idx[i]);
+  printf("]\n\tgather ints[idx]:               [");
+  for (int i = 0; i < LEN(gathered); i++) printf(i ? ", %d" : "%d", gathered[i]);
+  printf("]\n\tchecked idx:                    [");
+  for (int i = 0; i < LEN(checked_idx); i++) printf(i ? ", %u" : "%u", checked_idx[i]);
+  printf("]\n\tgather mungers[checked idx].f2: [");
+  for (int i = 0; i < LEN(gathered_f2); i++) printf(i ? ", %d" : "%d", gathered_f2[i]);
+  printf("]\n\tscatter ints[checked idx] = i:  [");
+  for (int i = 0; i < LEN(scattered); i++) printf(i ? ", %d" : "%d", scattered[i]);
+  printf("]\n");
+  printf("----------------------\n");
+
+  printf("\n--- testing foo/st_z_b fns (see end of gep.c) ---\n");
+  ST sts[2];
+  printf("\tfoo(s) - s:         %td (C: %td)\n", (char*) foo(sts) - (char*) sts, (char*) &sts[1].Z.B[5][13] - (char*) sts);
+  printf("\tst_z_b(s, 1, 2, 3): %td (C: %td)\n", (char*) st_z_b(sts, 1, 2, 3) - (char*) sts, (char*) &sts[1].Z.B[2][3] - (char*) sts);
+  printf("----------------------\n");
+
+  printf("\n--- layout of ST ---\n");
+  layout_print(mod, &st_layout);
+
+  LayoutType* st_reordered = layout_reorder(mod, &st_layout);
+
+  if (st_reordered)
+  {
+    printf("\n");
+    layout_print(mod, st_reordered);
+    layout_free(st_reordered);
+  }
+  printf("----------------------\n");
+
   // Write bitcode
   if (LLVMWriteBitcodeToFile(mod, "main.bc") != 0)
   {
@@ -192,6 +493,9 @@ int main (int argc, char const* argv[])
   fprintf(stderr, "--------------\n");
 
   // Cleanup
+  LLVMDisposeExecutionEngine(engine);
   LLVMDisposeModule(mod);
   LLVMContextDispose(ctx);
+  LLVMDisposeTargetData(td);
+  LLVMDisposeTargetMachine(tm_ref);
 }
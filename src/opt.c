@@ -0,0 +1,79 @@
+// Run the standard -O<n> pipeline over a module, roughly what `opt -O<n>` does
+//
+// - fn passes first (per fn cleanup), then module passes (inlining, loop opts, vectorization, ...)
+// - opt_level 0 is a no-op so callers can pass it through unconditionally
+//
+// Also tagging fns w/ the host CPU, w/o it codegen targets baseline x86-64 (no AVX) even when JITing
+
+#include <llvm-c/TargetMachine.h>
+#include <llvm-c/Transforms/PassManagerBuilder.h>
+
+#include "opt.h"
+#include "util.h"
+
+#include <string.h>
+
+void optimize_module (
+  LLVMModuleRef mod,
+  unsigned opt_level
+)
+{
+  if (opt_level == 0) return;
+
+  // Configure pipeline
+  LLVMPassManagerBuilderRef pmb = LLVMPassManagerBuilderCreate();
+  LLVMPassManagerBuilderSetOptLevel(pmb, opt_level);
+
+  if (opt_level > 1)
+  {
+    LLVMPassManagerBuilderUseInlinerWithThreshold(pmb, 275 /* same as clang -O2/-O3 */);
+  }
+
+  // Populate pass managers
+  LLVMPassManagerRef fn_pm  = LLVMCreateFunctionPassManagerForModule(mod);
+  LLVMPassManagerRef mod_pm = LLVMCreatePassManager();
+
+  LLVMPassManagerBuilderPopulateFunctionPassManager(pmb, fn_pm);
+  LLVMPassManagerBuilderPopulateModulePassManager(pmb, mod_pm);
+
+  // Run fn passes over every fn w/ a body
+  LLVMInitializeFunctionPassManager(fn_pm);
+
+  for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn))
+  {
+    if (!LLVMIsDeclaration(fn)) LLVMRunFunctionPassManager(fn_pm, fn);
+  }
+
+  LLVMFinalizeFunctionPassManager(fn_pm);
+
+  // Run module passes
+  LLVMRunPassManager(mod_pm, mod);
+
+  // Cleanup
+  LLVMDisposePassManager(mod_pm);
+  LLVMDisposePassManager(fn_pm);
+  LLVMPassManagerBuilderDispose(pmb);
+}
+
+void target_host_cpu (
+  LLVMModuleRef mod
+)
+{
+  LLVMContextRef ctx = LLVMGetModuleContext(mod);
+  char* cpu          = LLVMGetHostCPUName();
+  char* features     = LLVMGetHostCPUFeatures();
+
+  LLVMAttributeRef cpu_attr      = LLVMCreateStringAttribute(ctx, "target-cpu", 10, cpu, strlen(cpu));
+  LLVMAttributeRef features_attr = LLVMCreateStringAttribute(ctx, "target-features", 15, features, strlen(features));
+
+  for (LLVMValueRef fn = LLVMGetFirstFunction(mod); fn; fn = LLVMGetNextFunction(fn))
+  {
+    if (LLVMIsDeclaration(fn) || LLVMGetStringAttributeAtIndex(fn, LLVMAttributeFunctionIndex, "target-cpu", 10)) continue;
+
+    LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex, cpu_attr);
+    LLVMAddAttributeAtIndex(fn, LLVMAttributeFunctionIndex, features_attr);
+  }
+
+  LLVMDisposeMessage(features);
+  LLVMDisposeMessage(cpu);
+}
@@ -0,0 +1,12 @@
+#include <llvm-c/Core.h>
+
+void optimize_module (
+  LLVMModuleRef mod,
+  unsigned opt_level
+);
+
+// Tag every fn w/ the host's "target-cpu"/"target-features" so codegen may use e.g. AVX2/AVX-512
+// - only for code run on this machine (JIT), fns already tagged are left alone
+void target_host_cpu (
+  LLVMModuleRef mod
+);
@@ -4,6 +4,8 @@
 //  {
 //    return x + y;
 //  }
+//
+// - overflow behavior per IntMode (wrap, nsw/nuw, trap, saturate), see arith.c
 
 #include "sum.h"
 #include "util.h"
@@ -12,7 +14,8 @@ LLVMValueRef create_int_sum_fn (
   LLVMContextRef ctx,
   LLVMModuleRef mod,
   const char* name,
-  unsigned num_bits
+  unsigned num_bits,
+  IntMode mode
 )
 {
   // Types
@@ -25,6 +28,8 @@ LLVMValueRef create_int_sum_fn (
   LLVMTypeRef signature     = LLVMFunctionType(return_type, param_types, num_params, F);
   LLVMValueRef fn           = LLVMAddFunction(mod, name, signature);
 
+  set_int_ret_ext(ctx, fn, num_bits, mode);
+
   // Get args
   LLVMValueRef x = LLVMGetParam(fn, 0);
   LLVMValueRef y = LLVMGetParam(fn, 1);
@@ -42,7 +47,7 @@ LLVMValueRef create_int_sum_fn (
   LLVMPositionBuilderAtEnd(builder, entry);
 
   // Get values and apply to 'tmp'
-  LLVMValueRef tmp = LLVMBuildAdd(builder, x, y, "tmp");
+  LLVMValueRef tmp = build_int_add(builder, mod, mode, x, y, "tmp");
   LLVMBuildRet(builder, tmp); // Generate return statement
 
   // Cleanup
@@ -50,3 +55,205 @@ LLVMValueRef create_int_sum_fn (
 
   return fn;
 }
+
+// Adds in i<num_bits> on values stored as the storage width (scalar or vector), no-op conversions when they match
+static LLVMValueRef build_stored_int_add (
+  LLVMContextRef ctx,
+  LLVMBuilderRef builder,
+  LLVMModuleRef mod,
+  IntMode mode,
+  unsigned num_bits,
+  LLVMValueRef x,
+  LLVMValueRef y
+)
+{
+  LLVMTypeRef stored_type = LLVMTypeOf(x);
+  LLVMTypeRef int_type    = LLVMIntTypeInContext(ctx, num_bits);
+
+  if (LLVMGetTypeKind(stored_type) == LLVMVectorTypeKind)
+  {
+    int_type = LLVMVectorType(int_type, LLVMGetVectorSize(stored_type));
+  }
+
+  if (int_type == stored_type)
+  {
+    return build_int_add(builder, mod, mode, x, y, "");
+  }
+
+  // e.g. i17 kept in i32: trunc, add, extend back
+  LLVMValueRef x_n = LLVMBuildTrunc(builder, x, int_type, "");
+  LLVMValueRef y_n = LLVMBuildTrunc(builder, y, int_type, "");
+  LLVMValueRef sum = build_int_add(builder, mod, mode, x_n, y_n, "");
+
+  return int_mode_is_unsigned(mode)
+    ? LLVMBuildZExt(builder, sum, stored_type, "")
+    : LLVMBuildSExt(builder, sum, stored_type, "");
+}
+
+// Batch form w/ narrow ints packed densely into SIMD lanes:
+//
+//  void sum_vec (intS_t* result, intS_t* x, intS_t* y, size_t length)
+//  {
+//    size_t i = 0;
+//
+//    for (; i + LANES <= length; i += LANES)   // <LANES x iN> per op
+//      result[i:i+LANES] = x[i:i+LANES] + y[i:i+LANES];
+//
+//    for (; i < length; i++)                   // Tail
+//      result[i] = x[i] + y[i];
+//  }
+//
+// - intS_t is the storage width of num_bits (i8, i16, i32, i64), see int_storage_bits
+// - LANES = vector_bits / storage bits, so 128 bit vectors hold 16 x i8 or 8 x i16 instead of 4 promoted i32
+// - vector_bits must be a multiple of the storage width (0 is), NULL otherwise
+// - a single lane (e.g. i64 in 64 bit vectors) or vector_bits = 0 only emits the scalar loop
+LLVMValueRef create_int_sum_vec_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name,
+  unsigned num_bits,
+  IntMode mode,
+  unsigned vector_bits
+)
+{
+  // Lanes
+  unsigned storage_bits = int_storage_bits(num_bits);
+  unsigned num_lanes    = vector_bits / storage_bits;
+  int vectorize         = num_lanes > 1;
+
+  if (vector_bits % storage_bits != 0)
+  {
+    fprintf(stderr, "%s: %u vector bits is not a multiple of the i%u storage width\n", name, vector_bits, storage_bits);
+    return NULL;
+  }
+
+  // Types
+  LLVMTypeRef int64_type    = LLVMInt64TypeInContext(ctx);
+  LLVMTypeRef elem_type     = LLVMIntTypeInContext(ctx, storage_bits);
+  LLVMTypeRef elem_ptr_type = LLVMPointerType(elem_type, 0 /* AddressSpace */);
+  LLVMTypeRef vec_type      = vectorize ? LLVMVectorType(elem_type, num_lanes) : NULL;
+  LLVMTypeRef vec_ptr_type  = vectorize ? LLVMPointerType(vec_type, 0 /* AddressSpace */) : NULL;
+
+  // New fn: sum_vec (IntS*, IntS*, IntS*, Int64) Void
+  unsigned num_params       = 4;
+  LLVMTypeRef param_types[] = { elem_ptr_type, elem_ptr_type, elem_ptr_type, int64_type };
+  LLVMTypeRef return_type   = LLVMVoidTypeInContext(ctx);
+  LLVMTypeRef signature     = LLVMFunctionType(return_type, param_types, num_params, F);
+  LLVMValueRef fn           = LLVMAddFunction(mod, name, signature);
+
+  // Consts
+  LLVMValueRef zero  = LLVMConstInt(int64_type, 0, T /* sign extended */);
+  LLVMValueRef one   = LLVMConstInt(int64_type, 1, T /* sign extended */);
+  LLVMValueRef lanes = LLVMConstInt(int64_type, num_lanes, T /* sign extended */);
+
+  // Params
+  LLVMValueRef arg_result = LLVMGetParam(fn, 0);
+  LLVMValueRef arg_ptr_x  = LLVMGetParam(fn, 1);
+  LLVMValueRef arg_ptr_y  = LLVMGetParam(fn, 2);
+  LLVMValueRef arg_len    = LLVMGetParam(fn, 3);
+
+  // Create blocks
+  LLVMBasicBlockRef entry       = LLVMAppendBasicBlockInContext(ctx, fn, "entry");
+  LLVMBasicBlockRef vec_cond    = vectorize ? LLVMAppendBasicBlockInContext(ctx, fn, "vec_cond") : NULL;
+  LLVMBasicBlockRef vec_body    = vectorize ? LLVMAppendBasicBlockInContext(ctx, fn, "vec_body") : NULL;
+  LLVMBasicBlockRef scalar_cond = LLVMAppendBasicBlockInContext(ctx, fn, "scalar_cond");
+  LLVMBasicBlockRef scalar_body = LLVMAppendBasicBlockInContext(ctx, fn, "scalar_body");
+  LLVMBasicBlockRef end         = LLVMAppendBasicBlockInContext(ctx, fn, "end");
+
+  // Create and position builder
+  LLVMBuilderRef builder = LLVMCreateBuilderInContext(ctx);
+
+  // Entry
+  //   represents: i = 0
+  LLVMPositionBuilderAtEnd(builder, entry);
+
+  LLVMValueRef i_addr = LLVMBuildAlloca(builder, int64_type, "i");
+
+  LLVMBuildStore(builder, zero, i_addr);
+  LLVMBuildBr(builder, vectorize ? vec_cond : scalar_cond);
+
+  // Vector condition
+  //   represents: i + LANES <= length
+  if (vectorize)
+  {
+    LLVMPositionBuilderAtEnd(builder, vec_cond);
+
+    LLVMValueRef i       = LLVMBuildLoad2(builder, int64_type, i_addr, "");
+    LLVMValueRef i_lanes = LLVMBuildAdd(builder, i, lanes, "");
+    LLVMValueRef cond    = LLVMBuildICmp(builder, LLVMIntULE, i_lanes, arg_len, "");
+
+    LLVMBuildCondBr(builder, cond, vec_body, scalar_cond);
+  }
+
+  // Vector body
+  //   represents: result[i:i+LANES] = x[i:i+LANES] + y[i:i+LANES]; i += LANES
+  if (vectorize)
+  {
+    LLVMPositionBuilderAtEnd(builder, vec_body);
+
+    LLVMValueRef i = LLVMBuildLoad2(builder, int64_type, i_addr, "");
+    LLVMValueRef ptrs[3];
+    LLVMValueRef args[] = { arg_result, arg_ptr_x, arg_ptr_y };
+
+    for (int p = 0; p < 3; p++)
+    {
+      LLVMValueRef elem_ptr = LLVMBuildGEP2(builder, elem_type, args[p], &i, 1, "");
+      ptrs[p]               = LLVMBuildBitCast(builder, elem_ptr, vec_ptr_type, "");
+    }
+
+    // Arrays are only elem aligned
+    LLVMValueRef x_v = LLVMBuildLoad2(builder, vec_type, ptrs[1], "");
+    LLVMValueRef y_v = LLVMBuildLoad2(builder, vec_type, ptrs[2], "");
+
+    LLVMSetAlignment(x_v, storage_bits / 8);
+    LLVMSetAlignment(y_v, storage_bits / 8);
+
+    LLVMValueRef sum   = build_stored_int_add(ctx, builder, mod, mode, num_bits, x_v, y_v);
+    LLVMValueRef store = LLVMBuildStore(builder, sum, ptrs[0]);
+
+    LLVMSetAlignment(store, storage_bits / 8);
+
+    LLVMBuildStore(builder, LLVMBuildAdd(builder, i, lanes, ""), i_addr);
+    LLVMBuildBr(builder, vec_cond);
+  }
+
+  // Scalar condition
+  //   represents: i < length
+  {
+    LLVMPositionBuilderAtEnd(builder, scalar_cond);
+
+    LLVMValueRef i    = LLVMBuildLoad2(builder, int64_type, i_addr, "");
+    LLVMValueRef cond = LLVMBuildICmp(builder, LLVMIntULT, i, arg_len, "");
+
+    LLVMBuildCondBr(builder, cond, scalar_body, end);
+  }
+
+  // Scalar body
+  //   represents: result[i] = x[i] + y[i]; i++
+  {
+    LLVMPositionBuilderAtEnd(builder, scalar_body);
+
+    LLVMValueRef i      = LLVMBuildLoad2(builder, int64_type, i_addr, "");
+    LLVMValueRef x_addr = LLVMBuildGEP2(builder, elem_type, arg_ptr_x, &i, 1, "");
+    LLVMValueRef y_addr = LLVMBuildGEP2(builder, elem_type, arg_ptr_y, &i, 1, "");
+    LLVMValueRef x_i    = LLVMBuildLoad2(builder, elem_type, x_addr, "");
+    LLVMValueRef y_i    = LLVMBuildLoad2(builder, elem_type, y_addr, "");
+
+    LLVMValueRef sum         = build_stored_int_add(ctx, builder, mod, mode, num_bits, x_i, y_i);
+    LLVMValueRef result_addr = LLVMBuildGEP2(builder, elem_type, arg_result, &i, 1, "");
+
+    LLVMBuildStore(builder, sum, result_addr);
+    LLVMBuildStore(builder, LLVMBuildAdd(builder, i, one, ""), i_addr);
+    LLVMBuildBr(builder, scalar_cond);
+  }
+
+  // End
+  LLVMPositionBuilderAtEnd(builder, end);
+
+  LLVMBuildRetVoid(builder);
+
+  // Cleanup
+  LLVMDisposeBuilder(builder);
+
+  return fn;
+}
@@ -1,8 +1,23 @@
 #include <llvm-c/Core.h>
 
+#include "arith.h"
+
 LLVMValueRef create_int_sum_fn (
   LLVMContextRef ctx,
   LLVMModuleRef mod,
   const char* name,
-  unsigned num_bits
+  unsigned num_bits,
+  IntMode mode
+);
+
+// Batch form: name (IntS* result, IntS* x, IntS* y, Int64 length) Void, IntS is the storage width of num_bits
+// - vector_bits / storage width lanes per op, vector_bits must be a multiple of the storage width (NULL and no fn otherwise, e.g. i128 w/ 64 vector bits)
+// - falls back to the scalar loop when a single lane fits or vector_bits is 0
+LLVMValueRef create_int_sum_vec_fn (
+  LLVMContextRef ctx,
+  LLVMModuleRef mod,
+  const char* name,
+  unsigned num_bits,
+  IntMode mode,
+  unsigned vector_bits
 );